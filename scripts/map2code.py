@@ -18,6 +18,20 @@ class ColorException(Exception):
 MAP_ROWS = 11
 MAP_COLS = 19
 
+# Clearance is counted in quads up to this many, so that it fits in a byte in
+# pixels
+MAX_CLEARANCE_QUADS = 15
+QUAD_SIZE_PX = 16
+
+# Segment of impassable quads. This must match map.h
+SEGMENT_NONE = 0xFF
+
+# Neighbor mask bits. These must match enum direction in util.h
+NEIGHBOR_NORTH = 0x01
+NEIGHBOR_SOUTH = 0x02
+NEIGHBOR_EAST = 0x04
+NEIGHBOR_WEST = 0x08
+
 
 COLORS = [
     "black",
@@ -59,6 +73,86 @@ def get_tile_color(color):
     return color.upper()
 
 
+def neighbor_mask(passable, row_idx, col_idx):
+    mask = 0
+    if row_idx > 0 and passable[row_idx - 1][col_idx]:
+        mask |= NEIGHBOR_NORTH
+    if row_idx < MAP_ROWS - 1 and passable[row_idx + 1][col_idx]:
+        mask |= NEIGHBOR_SOUTH
+    if col_idx < MAP_COLS - 1 and passable[row_idx][col_idx + 1]:
+        mask |= NEIGHBOR_EAST
+    if col_idx > 0 and passable[row_idx][col_idx - 1]:
+        mask |= NEIGHBOR_WEST
+    return mask
+
+
+def spawn_quads(passable):
+    # Every passable quad on the edge of the map, going clockwise from the top
+    # left corner so that each corner is only listed once
+    edge = (
+        [(col_idx, 0) for col_idx in range(MAP_COLS)]
+        + [(MAP_COLS - 1, row_idx) for row_idx in range(1, MAP_ROWS)]
+        + [(col_idx, MAP_ROWS - 1) for col_idx in range(MAP_COLS - 2, -1, -1)]
+        + [(0, row_idx) for row_idx in range(MAP_ROWS - 2, 0, -1)]
+    )
+    return [(x, y) for x, y in edge if passable[y][x]]
+
+
+def clearance(passable, row_idx, col_idx, step_row, step_col):
+    # The number of pixels from the edge of the quad to the nearest impassable
+    # quad (or the edge of the map) in the direction of the step
+    count = 0
+    row_idx += step_row
+    col_idx += step_col
+    while (
+        count < MAX_CLEARANCE_QUADS
+        and 0 <= row_idx < MAP_ROWS
+        and 0 <= col_idx < MAP_COLS
+        and passable[row_idx][col_idx]
+    ):
+        count += 1
+        row_idx += step_row
+        col_idx += step_col
+    return count * QUAD_SIZE_PX
+
+
+def open_segments(lines):
+    # Numbers the runs of passable quads in each line (row or column). Returns
+    # the segment of each quad, and the first and last position of each
+    # segment along its line
+    segments = []
+    extents = []
+    for line in lines:
+        segments.append([])
+        for pos, passable in enumerate(line):
+            if not passable:
+                segments[-1].append(SEGMENT_NONE)
+                continue
+            if pos == 0 or not line[pos - 1]:
+                extents.append([pos, pos])
+            extents[-1][1] = pos
+            segments[-1].append(len(extents) - 1)
+    if len(extents) >= SEGMENT_NONE:
+        raise Exception("Too many open segments")
+    return segments, extents
+
+
+def write_quads(f, quads):
+    for row_idx, row in enumerate(quads):
+        f.write(f"        // Row {row_idx}\n")
+        f.write("        {\n")
+        for v in row:
+            f.write(f"            0x{v:02X},\n")
+        f.write("        },\n")
+
+
+def write_extents(f, name, extents):
+    f.write(f"static const struct map_segment {name}[] = {{\n")
+    for first, last in extents:
+        f.write(f"    {{{first}, {last}}},\n")
+    f.write("};\n")
+
+
 def main():
     parser = argparse.ArgumentParser(description="Convert map data file to code")
     parser.add_argument("input", type=Path, help="Input YAML data file")
@@ -113,6 +207,37 @@ def main():
                 legend[legend_name] = Tile(idx, image, color, passable)
                 f.write(f"    MAKE_LEGEND(MAP_IMAGE_{image}, COLOR_{color}),\n")
             f.write("};\n")
+
+            passable = []
+            for row_idx, row in enumerate(data):
+                passable.append([])
+                for col_idx, c in enumerate(row):
+                    if c not in legend:
+                        print(f"Unknown character {c} in {name}:{row_idx},{col_idx}")
+                        return 1
+                    passable[-1].append(legend[c].passable)
+
+            spawns = spawn_quads(passable)
+            if not spawns:
+                print(f"No passable quads on the edge of {name} to spawn in")
+                return 1
+
+            f.write(f"static const struct map_quad spawns_{name}[] = {{\n")
+            for x, y in spawns:
+                f.write(f"    {{{x}, {y}}},\n")
+            f.write("};\n")
+
+            row_segments, row_extents = open_segments(passable)
+            col_segments, col_extents = open_segments(
+                [[row[col_idx] for row in passable] for col_idx in range(MAP_COLS)]
+            )
+            # Both are indexed by row, then column
+            col_segments = [
+                [col_segments[col_idx][row_idx] for col_idx in range(MAP_COLS)]
+                for row_idx in range(MAP_ROWS)
+            ]
+            write_extents(f, f"row_segments_{name}", row_extents)
+            write_extents(f, f"col_segments_{name}", col_extents)
             f.write(
                 textwrap.dedent(
                     f"""\
@@ -129,10 +254,7 @@ def main():
             for row_idx, row in enumerate(data):
                 f.write(f"        // Row {row_idx}\n")
                 f.write("        {\n")
-                for col_idx, c in enumerate(row):
-                    if c not in legend:
-                        print(f"Unknown character {c} in {name}:{row_idx},{col_idx}")
-                        return 1
+                for c in row:
                     v = legend[c].idx
                     if legend[c].passable:
                         v |= 0x80
@@ -140,6 +262,47 @@ def main():
                 f.write("        },\n")
 
             f.write("   },\n")
+
+            # The passable neighbors of each quad, with the edges of the map
+            # counted as impassable
+            f.write("   {\n")
+            for row_idx in range(MAP_ROWS):
+                f.write(f"        // Row {row_idx}\n")
+                f.write("        {\n")
+                for col_idx in range(MAP_COLS):
+                    mask = neighbor_mask(passable, row_idx, col_idx)
+                    f.write(f"            0x{mask:02X},\n")
+                f.write("        },\n")
+            f.write("   },\n")
+            f.write(f"   spawns_{name},\n")
+            f.write(f"   {len(spawns)},\n")
+
+            # The open segment of each quad in its row and in its column
+            f.write("   {\n")
+            write_quads(f, row_segments)
+            f.write("   },\n")
+            f.write("   {\n")
+            write_quads(f, col_segments)
+            f.write("   },\n")
+            f.write(f"   row_segments_{name},\n")
+            f.write(f"   col_segments_{name},\n")
+
+            # The clearance of each quad, in the order of enum direction
+            f.write("   {\n")
+            for step_row, step_col in ((-1, 0), (1, 0), (0, 1), (0, -1)):
+                f.write("    {\n")
+                write_quads(
+                    f,
+                    [
+                        [
+                            clearance(passable, row_idx, col_idx, step_row, step_col)
+                            for col_idx in range(MAP_COLS)
+                        ]
+                        for row_idx in range(MAP_ROWS)
+                    ],
+                )
+                f.write("    },\n")
+            f.write("   },\n")
             f.write("};\n\n")
 
     return 0
@@ -13,26 +13,30 @@
 #include "reg.h"
 #include "util.h"
 
+uint16_t raster_lines_per_frame = 312;
+
 uint16_t get_raster(void) {
     return (VICII_CTRL_1 & _BV(VICII_RST8_BIT)) << 1 | VICII_RASTER;
 }
 
-void put_char_xy(uint8_t x, uint8_t y, uint8_t c) {
-    DISABLE_INTERRUPTS() {
-        ALL_RAM() { screen_data[y][x] = c; }
+// Returns the number of raster lines since start, which must be less than a
+// frame ago
+uint16_t get_raster_elapsed(uint16_t start) {
+    uint16_t raster = get_raster();
+    if (raster < start) {
+        raster += raster_lines_per_frame;
     }
+    return raster - start;
 }
 
+void put_char_xy(uint8_t x, uint8_t y, uint8_t c) { screen_data[y][x] = c; }
+
 void put_string_xy(uint8_t x, uint8_t y, char const *c) {
     uint8_t *p = &screen_data[y][x];
-    DISABLE_INTERRUPTS() {
-        ALL_RAM() {
-            while (*c) {
-                *p = *c;
-                p++;
-                c++;
-            }
-        }
+    while (*c) {
+        *p = *c;
+        p++;
+        c++;
     }
 }
 
@@ -51,12 +55,8 @@ void set_color(uint8_t x, uint8_t y, uint8_t color) {
 }
 
 void fill_char(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t c) {
-    DISABLE_INTERRUPTS() {
-        ALL_RAM() {
-            for (uint8_t y = y1; y <= y2; y++) {
-                memset(&screen_data[y][x1], c, (x2 - x1) + 1);
-            }
-        }
+    for (uint8_t y = y1; y <= y2; y++) {
+        memset(&screen_data[y][x1], c, (x2 - x1) + 1);
     }
 }
 
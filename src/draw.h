@@ -9,7 +9,12 @@
 
 struct map_screen;
 
+// Number of raster lines in a frame. This defaults to PAL, and is set once the
+// video type has been detected
+extern uint16_t raster_lines_per_frame;
+
 uint16_t get_raster(void);
+uint16_t get_raster_elapsed(uint16_t start);
 
 void put_char_xy(uint8_t x, uint8_t y, uint8_t c);
 void put_string_xy(uint8_t x, uint8_t y, char const *c);
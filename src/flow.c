@@ -0,0 +1,115 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#include "flow.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "map.h"
+#include "util.h"
+
+// Number of quads the search visits each tick, so that a new field for the
+// whole map is found over about 9 ticks
+#define FLOW_QUADS_PER_TICK (24)
+
+#define FLOW_NUM_QUADS (MAP_WIDTH_QUAD * MAP_HEIGHT_QUAD)
+
+// The last complete field is used by the mobs while the next one is built in
+// the other buffer
+static uint8_t flow_dirs[2][MAP_HEIGHT_QUAD][MAP_WIDTH_QUAD];
+static uint8_t flow_front;
+static bool flow_building;
+// Target of the field being built, or of the front field when not building
+static uint8_t flow_target_x;
+static uint8_t flow_target_y;
+
+// Breadth first search queue. Each quad is added at most once, so it never
+// wraps
+static uint8_t flow_queue_x[FLOW_NUM_QUADS];
+static uint8_t flow_queue_y[FLOW_NUM_QUADS];
+static uint8_t flow_queue_head;
+static uint8_t flow_queue_tail;
+
+static void flow_visit(uint8_t x, uint8_t y, enum direction dir) {
+    uint8_t(*back)[MAP_WIDTH_QUAD] = flow_dirs[flow_front ^ 1];
+
+    if (back[y][x] != FLOW_NONE) {
+        return;
+    }
+
+    back[y][x] = dir;
+    flow_queue_x[flow_queue_tail] = x;
+    flow_queue_y[flow_queue_tail] = y;
+    flow_queue_tail++;
+}
+
+static void start_flow(uint8_t target_quad_x, uint8_t target_quad_y) {
+    uint8_t(*back)[MAP_WIDTH_QUAD] = flow_dirs[flow_front ^ 1];
+
+    memset(back, FLOW_NONE, sizeof(flow_dirs[0]));
+    back[target_quad_y][target_quad_x] = FLOW_AT_TARGET;
+
+    flow_target_x = target_quad_x;
+    flow_target_y = target_quad_y;
+    flow_queue_x[0] = target_quad_x;
+    flow_queue_y[0] = target_quad_y;
+    flow_queue_head = 0;
+    flow_queue_tail = 1;
+    flow_building = true;
+}
+
+// Searches outward from the target, visiting at most max_quads quads. Each
+// quad found is pointed back at the quad it was found from
+static void search_flow(uint8_t max_quads) {
+    for (uint8_t n = 0; n < max_quads; n++) {
+        if (flow_queue_head == flow_queue_tail) {
+            flow_front ^= 1;
+            flow_building = false;
+            return;
+        }
+
+        uint8_t x = flow_queue_x[flow_queue_head];
+        uint8_t y = flow_queue_y[flow_queue_head];
+        uint8_t neighbors = map_tile_get_neighbors(x, y);
+        flow_queue_head++;
+
+        if (neighbors & MAP_NEIGHBOR(NORTH)) {
+            flow_visit(x, y - 1, SOUTH);
+        }
+        if (neighbors & MAP_NEIGHBOR(SOUTH)) {
+            flow_visit(x, y + 1, NORTH);
+        }
+        if (neighbors & MAP_NEIGHBOR(EAST)) {
+            flow_visit(x + 1, y, WEST);
+        }
+        if (neighbors & MAP_NEIGHBOR(WEST)) {
+            flow_visit(x - 1, y, EAST);
+        }
+    }
+}
+
+// Builds the whole field at once, for use when the game is not running
+void init_flow(uint8_t target_quad_x, uint8_t target_quad_y) {
+    start_flow(target_quad_x, target_quad_y);
+    while (flow_building) {
+        search_flow(FLOW_NUM_QUADS);
+    }
+}
+
+// Continues building the next field. A new one is only started once the
+// current one is complete, so that a target that moves every tick still gets
+// a field
+void tick_flow(uint8_t target_quad_x, uint8_t target_quad_y) {
+    if (!flow_building) {
+        if (target_quad_x == flow_target_x && target_quad_y == flow_target_y) {
+            return;
+        }
+        start_flow(target_quad_x, target_quad_y);
+    }
+    search_flow(FLOW_QUADS_PER_TICK);
+}
+
+uint8_t flow_get_dir(uint8_t quad_x, uint8_t quad_y) {
+    return flow_dirs[flow_front][quad_y][quad_x];
+}
@@ -0,0 +1,19 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#ifndef _FLOW_H
+#define _FLOW_H
+
+#include <stdint.h>
+
+// A flow field gives the direction (an enum direction) to move from each quad
+// to get one quad closer to the target quad, following the shortest passable
+// path. It is shared by all the mobs chasing the same target
+#define FLOW_NONE (0xFF)
+#define FLOW_AT_TARGET (0xFE)
+
+void init_flow(uint8_t target_quad_x, uint8_t target_quad_y);
+void tick_flow(uint8_t target_quad_x, uint8_t target_quad_y);
+uint8_t flow_get_dir(uint8_t quad_x, uint8_t quad_y);
+
+#endif
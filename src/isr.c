@@ -8,34 +8,157 @@
 
 #include "player.h"
 #include "reg.h"
+#include "sprite.h"
 #include "util.h"
 
+// The flags of a command are used directly by the ISR to select a handler
+// specialized for that combination of flags, so they must match the values in
+// isr-handler.S and fit in RASTER_NUM_OPS
 #define RASTER_VICII_BG _BV(0)
-#define RASTER_VICII_CTRL_2 _BV(1)
+#define RASTER_REGS _BV(1)
 #define RASTER_LAST _BV(2)
 #define RASTER_SPRITE _BV(3)
+#define RASTER_NUM_OPS (16)
+
+_Static_assert((RASTER_VICII_BG | RASTER_REGS | RASTER_LAST |
+                RASTER_SPRITE) < RASTER_NUM_OPS,
+               "Raster flags do not fit in the ISR jump table");
+
+// The raster commands are stored in two banks. The ISR walks the front bank
+// while the main loop builds the next frame in the back bank, and the banks
+// are swapped by the ISR when it reaches the RASTER_LAST command
+#define RASTER_NUM_CMDS (RASTER_NUM_BANKS * MAX_RASTER_CMDS)
+
+// Or'd with the bank number in raster_bank_ready when the main loop has
+// finished building a bank
+#define RASTER_BANK_READY _BV(7)
+
+// Sprite commands starting within this many lines of each other are run back
+// to back by a single interrupt. This matches the window in which the ISR would
+// otherwise busy wait for the next line instead of returning
+#define RASTER_COALESCE_LINES (3)
+
+// Number of lines the ISR takes to run one sprite command, rounded up
+#define RASTER_SPRITE_CMD_LINES (2)
+
+// Lines where the VIC-II steals the bus to fetch character data are only
+// possible in the display window
+#define RASTER_BADLINE_FIRST (0x30)
+#define RASTER_BADLINE_LAST (0xF7)
 
 uint8_t frame_count = 0;
 
+// Index of the next command the ISR will run, across all banks
 uint8_t __zeropage raster_cmd_idx;
 
-uint8_t __zeropage vicii_bg_0_next[MAX_RASTER_CMDS];
-uint8_t __zeropage vicii_ctrl_2_next[MAX_RASTER_CMDS];
-uint8_t __zeropage vicii_raster_next[MAX_RASTER_CMDS];
-uint8_t __zeropage raster_flags[MAX_RASTER_CMDS];
-uint8_t __zeropage raster_sprite_idx[MAX_RASTER_CMDS];
-uint8_t __zeropage raster_sprite_pointer[MAX_RASTER_CMDS];
-uint8_t __zeropage raster_sprite_color[MAX_RASTER_CMDS];
-uint8_t __zeropage raster_sprite_x[MAX_RASTER_CMDS];
-uint8_t __zeropage raster_sprite_y[MAX_RASTER_CMDS];
-uint8_t __zeropage raster_sprite_msb[MAX_RASTER_CMDS];
-uint8_t __zeropage raster_sprite_x_expand[MAX_RASTER_CMDS];
-uint8_t __zeropage raster_sprite_y_expand[MAX_RASTER_CMDS];
-uint8_t __zeropage raster_sprite_multicolor[MAX_RASTER_CMDS];
+// Bank the ISR is currently walking. Only written by the ISR
+volatile uint8_t __zeropage raster_front_bank;
+
+// Bank that the ISR should switch to at the end of the current frame. Only a
+// single store is needed to publish or cancel a bank, so the main loop never
+// needs to disable interrupts to hand off commands
+volatile uint8_t __zeropage raster_bank_ready;
+
+const uint8_t raster_bank_start[RASTER_NUM_BANKS] = {0, MAX_RASTER_CMDS};
+uint8_t raster_first_line[RASTER_NUM_BANKS];
+
+static uint8_t raster_build_bank;
+static uint8_t raster_build_idx;
+
+// Line of each command in the bank being built. These are linked into
+// vicii_raster_next when the bank is finished
+static uint8_t raster_build_line[RASTER_NUM_CMDS];
+
+// The ISR reads these for every command, so they are kept in zero page as long
+// as they fit in a reasonable part of it
+#if RASTER_NUM_CMDS <= 16
+#define RASTER_ZEROPAGE __zeropage
+#else
+#define RASTER_ZEROPAGE
+#endif
+
+uint8_t RASTER_ZEROPAGE vicii_raster_next[RASTER_NUM_CMDS];
+uint8_t RASTER_ZEROPAGE raster_flags[RASTER_NUM_CMDS];
+
+// The ISR only accesses these using absolute indexed addressing, which takes
+// the same number of cycles as zero page indexed, so they are kept out of zero
+// page
+uint8_t vicii_bg_0_next[RASTER_NUM_CMDS];
+// Index of the first register write in raster_reg_addr/raster_reg_value for
+// each RASTER_REGS command
+uint8_t raster_reg_start[RASTER_NUM_CMDS];
+uint8_t raster_sprite_idx[RASTER_NUM_CMDS];
+uint8_t raster_sprite_pointer[RASTER_NUM_CMDS];
+uint8_t raster_sprite_color[RASTER_NUM_CMDS];
+uint8_t raster_sprite_x[RASTER_NUM_CMDS];
+uint8_t raster_sprite_y[RASTER_NUM_CMDS];
+uint8_t raster_sprite_msb[RASTER_NUM_CMDS];
+uint8_t raster_sprite_x_expand[RASTER_NUM_CMDS];
+uint8_t raster_sprite_y_expand[RASTER_NUM_CMDS];
+uint8_t raster_sprite_multicolor[RASTER_NUM_CMDS];
 uint8_t num_missed_sprites;
 uint8_t last_num_missed_sprites;
 
-static uint8_t first_line;
+// Register writes for RASTER_REGS commands. Each bank has its own list, and
+// the writes for each command are terminated with RASTER_REG_END
+#define RASTER_REG_LIST_SIZE (16)
+#define RASTER_REG_END (0xFF)
+
+_Static_assert(RASTER_NUM_BANKS * RASTER_REG_LIST_SIZE <= 256,
+               "Register write list too large");
+
+uint8_t raster_reg_addr[RASTER_NUM_BANKS * RASTER_REG_LIST_SIZE];
+uint8_t raster_reg_value[RASTER_NUM_BANKS * RASTER_REG_LIST_SIZE];
+static uint8_t raster_build_reg_idx;
+
+// Sprite to sprite collisions latched by the ISR after running each command.
+// Each one covers the lines from the previous command up to this one
+uint8_t raster_collision[RASTER_NUM_CMDS];
+
+// Set by the ISR for each sprite command it could not draw in time. The
+// collisions around these commands don't show where the sprites really were
+uint8_t raster_missed[RASTER_NUM_CMDS];
+
+// Frame in which the ISR finished latching the collisions for each bank
+uint8_t raster_collision_frame[RASTER_NUM_BANKS];
+
+#ifdef DEBUG
+// Statistics for each frame, written by the ISR to a ring buffer at the end of
+// the frame. raster_telemetry_head is the byte offset of the entry that will be
+// written next. The layout must match isr-handler.S
+struct raster_telemetry {
+    uint8_t frame;
+    uint8_t num_cmds;
+    uint8_t missed_sprites;
+    // Worst number of lines the interrupt was late by
+    uint8_t late_lines;
+    // Number of commands that were run by busy waiting in the ISR
+    uint8_t num_syncs;
+    uint8_t reserved;
+    // Raster line where the main loop finished. 0xFFFF if it did not finish
+    // before the end of the frame
+    uint16_t main_line;
+};
+
+_Static_assert(sizeof(struct raster_telemetry) == 8,
+               "Wrong raster telemetry size");
+
+#define RASTER_TELEMETRY_ENTRIES (16)
+
+struct raster_telemetry raster_telemetry[RASTER_TELEMETRY_ENTRIES];
+uint8_t raster_telemetry_head;
+
+uint8_t raster_telemetry_cmds;
+uint8_t raster_telemetry_missed;
+uint8_t raster_telemetry_late;
+uint8_t raster_telemetry_syncs;
+uint8_t raster_telemetry_target_line;
+uint16_t raster_telemetry_main_line;
+
+void raster_telemetry_main_done(uint16_t line) {
+    DISABLE_INTERRUPTS() { raster_telemetry_main_line = line; }
+}
+#endif
 
 void frame_wait(void) {
     static uint8_t next_frame = 0;
@@ -49,30 +172,174 @@ void wait_frames(uint16_t num_frames) {
     }
 }
 
+void init_raster_cmds(void) {
+    // Start the ISR on a bank with a single empty command, so that it will
+    // switch to the first bank built by the main loop at the top of the frame
+    raster_front_bank = 0;
+    raster_bank_ready = 0;
+    raster_cmd_idx = 0;
+    raster_flags[0] = RASTER_LAST;
+    raster_first_line[0] = 0;
+
+    VICII_RASTER = 0;
+    VICII_CTRL_1 &= ~_BV(VICII_RST8_BIT);
+}
+
 void prepare_raster_cmds(void) {
-    raster_cmd_idx = 0xFF;
+    // Cancel any finished bank the ISR has not switched to yet. Once this is
+    // done the ISR cannot change banks, so the bank it is not walking is free
+    // to be rebuilt
+    raster_bank_ready = 0;
+    raster_build_bank = raster_front_bank ^ 1;
+    raster_build_idx = RASTER_CMD_NONE;
+    raster_build_reg_idx = raster_build_bank * RASTER_REG_LIST_SIZE;
+    sprite_shadow = &sprite_shadows[raster_build_bank];
+
     last_num_missed_sprites = num_missed_sprites;
     num_missed_sprites = 0;
 }
 
+static bool raster_is_badline(uint8_t line, uint8_t yscroll) {
+    return line >= RASTER_BADLINE_FIRST && line <= RASTER_BADLINE_LAST &&
+           (line & VICII_YSCROLL_MASK) == yscroll;
+}
+
+// Returns the latest line a sprite command can start on and still have the
+// ISR write the sprite before the raster reaches its top, assuming it is run
+// as the num_cmds'th command of the interrupt
+static uint8_t raster_sprite_deadline(uint8_t idx, uint8_t num_cmds) {
+    uint8_t lines = num_cmds * RASTER_SPRITE_CMD_LINES;
+    if (raster_sprite_y[idx] <= lines) {
+        return 0;
+    }
+    return raster_sprite_y[idx] - lines;
+}
+
+void schedule_raster_cmds(void) {
+    uint8_t yscroll = VICII_CTRL_1 & VICII_YSCROLL_MASK;
+    uint8_t idx = raster_bank_start[raster_build_bank];
+
+    while (idx <= raster_build_idx) {
+        if (!(raster_flags[idx] & RASTER_SPRITE)) {
+            idx++;
+            continue;
+        }
+
+        // Grow a group of sprite commands that can all be run by one
+        // interrupt. Commands can only be moved later (moving them earlier
+        // would cut off the bottom of the sprite that previously used the
+        // hardware sprite), so the group runs at the line of its last command
+        uint8_t line = raster_build_line[idx];
+        uint8_t deadline = raster_sprite_deadline(idx, 1);
+        uint8_t end = idx + 1;
+        uint8_t num_cmds = 1;
+
+        while (end <= raster_build_idx && (raster_flags[end] & RASTER_SPRITE)) {
+            uint8_t next_line = raster_build_line[end];
+            if (next_line - raster_build_line[idx] > RASTER_COALESCE_LINES) {
+                break;
+            }
+
+            uint8_t next_deadline = raster_sprite_deadline(end, num_cmds + 1);
+            if (next_deadline > deadline) {
+                next_deadline = deadline;
+            }
+            if (next_line >= next_deadline) {
+                break;
+            }
+
+            line = next_line;
+            deadline = next_deadline;
+            end++;
+            num_cmds++;
+        }
+
+        // A badline leaves too few cycles to reliably finish the sprite writes
+        // on the same line, so start one line later if there is time
+        if (raster_is_badline(line, yscroll) && line + 1 < deadline &&
+            (end > raster_build_idx || line + 1 <= raster_build_line[end])) {
+            line++;
+        }
+
+        for (; idx < end; idx++) {
+            raster_build_line[idx] = line;
+        }
+    }
+}
+
 void finish_raster_cmds(void) {
-    vicii_raster_next[raster_cmd_idx] = first_line;
-    raster_flags[raster_cmd_idx] |= RASTER_LAST;
-    raster_cmd_idx = 0;
+    uint8_t start = raster_bank_start[raster_build_bank];
+
+    raster_first_line[raster_build_bank] = raster_build_line[start];
+    for (uint8_t idx = start; idx < raster_build_idx; idx++) {
+        vicii_raster_next[idx] = raster_build_line[idx + 1];
+    }
+    raster_flags[raster_build_idx] |= RASTER_LAST;
+
+    // All of the commands must be written before the bank is handed off
+    asm volatile("" ::: "memory");
+    raster_bank_ready = RASTER_BANK_READY | raster_build_bank;
+
     VICII_INTERRUPT_ENABLE |= _BV(VICII_RST_BIT);
 }
 
 uint8_t alloc_raster_cmd(uint8_t raster_line) {
-    if (raster_cmd_idx == 0xFF) {
-        VICII_RASTER = raster_line;
-        VICII_CTRL_1 &= ~_BV(VICII_RST8_BIT);
-        first_line = raster_line;
+    if (raster_build_idx == RASTER_CMD_NONE) {
+        raster_build_idx = raster_bank_start[raster_build_bank];
     } else {
-        vicii_raster_next[raster_cmd_idx] = raster_line;
+        raster_build_idx++;
     }
-    raster_cmd_idx++;
-    raster_flags[raster_cmd_idx] = 0;
-    return raster_cmd_idx;
+    raster_build_line[raster_build_idx] = raster_line;
+    raster_flags[raster_build_idx] = 0;
+    raster_missed[raster_build_idx] = 0;
+    return raster_build_idx;
+}
+
+uint8_t raster_get_build_bank(void) { return raster_build_bank; }
+
+// The collisions in the bank being built are only from the frame that was just
+// displayed if the ISR switched away from it at the end of that frame. If the
+// main loop has fallen behind, they are stale
+bool raster_collisions_valid(void) {
+    return *(volatile uint8_t*)&raster_collision_frame[raster_build_bank] ==
+           *(volatile uint8_t*)&frame_count;
+}
+
+// Returns all of the collisions latched in the zones between first_idx and
+// last_idx of the bank being built in which one of the sprite_mask sprites
+// collided. A first_idx of RASTER_CMD_NONE starts at the first command in the
+// bank, and a last_idx of RASTER_CMD_NONE ends at the last command. If the
+// ISR missed the command that started the range (the one before first_idx) or
+// any command in it, RASTER_COLLISION_MISSED is returned. This must be called
+// before any commands are allocated for the next frame
+uint8_t raster_get_sprite_collisions(uint8_t first_idx, uint8_t last_idx,
+                                     uint8_t sprite_mask) {
+    uint8_t collisions = 0;
+    uint8_t idx = first_idx;
+    uint8_t end_idx = raster_bank_start[raster_build_bank] + MAX_RASTER_CMDS;
+
+    if (idx == RASTER_CMD_NONE) {
+        idx = raster_bank_start[raster_build_bank];
+    } else if (raster_missed[idx - 1]) {
+        return RASTER_COLLISION_MISSED;
+    }
+
+    // The walk never leaves the bank, even if the range is stale
+    while (idx < end_idx) {
+        if (raster_missed[idx]) {
+            return RASTER_COLLISION_MISSED;
+        }
+
+        if (raster_collision[idx] & sprite_mask) {
+            collisions |= raster_collision[idx];
+        }
+
+        if (idx == last_idx || (raster_flags[idx] & RASTER_LAST)) {
+            break;
+        }
+        idx++;
+    }
+    return collisions;
 }
 
 void raster_set_vicii_bg_color(uint8_t idx, uint8_t bg_color) {
@@ -80,9 +347,36 @@ void raster_set_vicii_bg_color(uint8_t idx, uint8_t bg_color) {
     vicii_bg_0_next[idx] = bg_color;
 }
 
+// Adds a register write to a command. All of the writes for a command must be
+// added before the next command is allocated. If the list for the bank is
+// full, the write is dropped
+void raster_set_reg(uint8_t idx, uint8_t reg, uint8_t value) {
+    uint8_t first = raster_build_bank * RASTER_REG_LIST_SIZE;
+    uint8_t used = raster_build_reg_idx - first;
+
+    if (!(raster_flags[idx] & RASTER_REGS)) {
+        // Start after the terminator of the previous command's list
+        if (used) {
+            used++;
+        }
+        if (used >= RASTER_REG_LIST_SIZE - 1) {
+            return;
+        }
+        raster_build_reg_idx = first + used;
+        raster_flags[idx] |= RASTER_REGS;
+        raster_reg_start[idx] = raster_build_reg_idx;
+    } else if (used >= RASTER_REG_LIST_SIZE - 1) {
+        return;
+    }
+
+    raster_reg_addr[raster_build_reg_idx] = reg;
+    raster_reg_value[raster_build_reg_idx] = value;
+    raster_build_reg_idx++;
+    raster_reg_addr[raster_build_reg_idx] = RASTER_REG_END;
+}
+
 void raster_set_vicii_ctrl_2(uint8_t idx, uint8_t ctrl_2) {
-    raster_flags[idx] |= RASTER_VICII_CTRL_2;
-    vicii_ctrl_2_next[idx] = ctrl_2;
+    raster_set_reg(idx, RASTER_REG(VICII_CTRL_2), ctrl_2);
 }
 
 void raster_set_sprite(uint8_t idx, uint8_t sprite_idx, uint8_t sprite_pointer,
@@ -7,23 +7,55 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-#define MAX_RASTER_CMDS (5)
+#include "mobs.h"
+
+// One command for each multiplexed mob sprite, plus the status bar and done
+// commands
+#define MAX_RASTER_CMDS (MAX_MOBS - NUM_MOB_SPRITES + 2)
+
+#define RASTER_NUM_BANKS (2)
+#define RASTER_CMD_NONE (0xFF)
+
+// Returned by raster_get_sprite_collisions() when a sprite command in the range
+// was missed. Every sprite is reported, so all of the checks are still done
+#define RASTER_COLLISION_MISSED (0xFF)
 
 extern uint8_t frame_count;
 extern uint8_t last_num_missed_sprites;
 
 void isr_handler(void);
+void isr_irq_entry(void);
+void isr_nmi(void);
 
 void frame_wait(void);
 void wait_frames(uint16_t num_frames);
 
+void init_raster_cmds(void);
 void prepare_raster_cmds(void);
+void schedule_raster_cmds(void);
 void finish_raster_cmds(void);
 
 uint8_t alloc_raster_cmd(uint8_t raster_line);
+uint8_t raster_get_build_bank(void);
+
+#ifdef DEBUG
+void raster_telemetry_main_done(uint16_t line);
+#endif
+
+bool raster_collisions_valid(void);
+uint8_t raster_get_sprite_collisions(uint8_t first_idx, uint8_t last_idx,
+                                     uint8_t sprite_mask);
+
+// Encodes a VIC-II or SID register for raster_set_reg(). VIC-II registers are
+// 0x00-0x3F and SID registers are 0x40-0x7F, which lets the ISR write both with
+// a single store indexed from $D3C0 (the last mirror of the VIC-II registers)
+#define RASTER_REG(reg)                       \
+    ((uint8_t)(((uint16_t)&(reg) & 0x3F) |   \
+               (((uint16_t)&(reg) & 0x0400) ? 0x40 : 0)))
 
+void raster_set_reg(uint8_t idx, uint8_t reg, uint8_t value);
 void raster_set_vicii_bg_color(uint8_t idx, uint8_t bg_color);
-void raster_set_vicii_ctrl_2(uint8_t idx, uint8_t ctrl_1);
+void raster_set_vicii_ctrl_2(uint8_t idx, uint8_t ctrl_2);
 void raster_set_sprite(uint8_t idx, uint8_t sprite_idx, uint8_t sprite_pointer,
                        uint8_t sprite_x, uint8_t sprite_y, uint8_t color,
                        uint8_t sprite_msb, uint8_t sprite_x_expand,
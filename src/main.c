@@ -11,6 +11,7 @@
 #include "bcd.h"
 #include "chars.h"
 #include "draw.h"
+#include "flow.h"
 #include "input.h"
 #include "isr.h"
 #include "map.h"
@@ -19,13 +20,11 @@
 #include "player-sprite.h"
 #include "player.h"
 #include "reg.h"
+#include "spawn.h"
 #include "sprite.h"
 #include "store.h"
 #include "tick.h"
 
-_Static_assert(MAX_RASTER_CMDS == MAX_MOBS - 6 + 2,
-               "Wrong number of raster command");
-
 // 67 is a bad line so we start right after that
 #define STATUS_INT_LINE (68)
 
@@ -74,9 +73,12 @@ static bcd_u16 score = 0;
 static bool score_updated;
 static bool is_ntsc;
 
-static struct {
-    uint8_t arrow_cool_down[MAX_MOBS];
-} skeleton_archer;
+static const uint16_t skeleton_speeds[] = {
+    MOB_SPEED(1, 1),
+    MOB_SPEED(1, 2),
+    MOB_SPEED(1, 3),
+    MOB_SPEED(1, 4),
+};
 
 static uint8_t quad_distance(uint8_t quad_x1, uint8_t quad_y1, uint8_t quad_x2,
                              uint8_t quad_y2) {
@@ -86,7 +88,7 @@ static uint8_t quad_distance(uint8_t quad_x1, uint8_t quad_y1, uint8_t quad_x2,
     if (quad_x1 > quad_x2) {
         xdist = quad_x1 - quad_x2;
     } else {
-        xdist = quad_x2 - quad_x2;
+        xdist = quad_x2 - quad_x1;
     }
 
     if (quad_y1 > quad_y2) {
@@ -102,36 +104,33 @@ static void random_move(uint8_t mob_quad_x, uint8_t mob_quad_y,
     // Randomly pick a direction. If that quad is passable, move there
     // otherwise check the other directions
     uint8_t r = rand();
+    uint8_t neighbors = map_tile_get_neighbors(mob_quad_x, mob_quad_y);
 #pragma clang loop unroll(full)
     for (uint8_t i = 0; i < 4; i++) {
         switch ((r + i & 0x3)) {
             case NORTH:
-                if (mob_quad_y > 0 &&
-                    map_tile_is_passable(mob_quad_x, mob_quad_y - 1)) {
+                if (neighbors & MAP_NEIGHBOR(NORTH)) {
                     *next_quad_x = mob_quad_x;
                     *next_quad_y = mob_quad_y - 1;
                     return;
                 }
                 break;
             case SOUTH:
-                if (mob_quad_y < MAP_HEIGHT_QUAD - 1 &&
-                    map_tile_is_passable(mob_quad_x, mob_quad_y + 1)) {
+                if (neighbors & MAP_NEIGHBOR(SOUTH)) {
                     *next_quad_x = mob_quad_x;
                     *next_quad_y = mob_quad_y + 1;
                     return;
                 }
                 break;
             case EAST:
-                if (mob_quad_x < MAP_WIDTH_QUAD - 1 &&
-                    map_tile_is_passable(mob_quad_x + 1, mob_quad_y)) {
+                if (neighbors & MAP_NEIGHBOR(EAST)) {
                     *next_quad_x = mob_quad_x + 1;
                     *next_quad_y = mob_quad_y;
                     return;
                 }
                 break;
             case WEST:
-                if (mob_quad_x > 0 &&
-                    map_tile_is_passable(mob_quad_x - 1, mob_quad_y)) {
+                if (neighbors & MAP_NEIGHBOR(WEST)) {
                     *next_quad_x = mob_quad_x - 1;
                     *next_quad_y = mob_quad_y;
                     return;
@@ -149,6 +148,7 @@ static void move_relative_quad(bool toward, uint8_t r, uint8_t mob_quad_x,
     //
     // Check all 4 directions, starting with a random one, and choose the
     // one that has the shortest distance
+    uint8_t neighbors = map_tile_get_neighbors(mob_quad_x, mob_quad_y);
     uint8_t best_dist = 0xFF;
     if (toward) {
         best_dist = 0xFF;
@@ -159,8 +159,7 @@ static void move_relative_quad(bool toward, uint8_t r, uint8_t mob_quad_x,
     for (uint8_t i = 0; i < 4; i++) {
         switch ((r + i & 0x3)) {
             case NORTH:
-                if (mob_quad_y > 0 &&
-                    map_tile_is_passable(mob_quad_x, mob_quad_y - 1)) {
+                if (neighbors & MAP_NEIGHBOR(NORTH)) {
                     uint8_t d = quad_distance(mob_quad_x, mob_quad_y - 1,
                                               target_quad_x, target_quad_y);
                     if ((toward && d < best_dist) ||
@@ -173,8 +172,7 @@ static void move_relative_quad(bool toward, uint8_t r, uint8_t mob_quad_x,
                 break;
 
             case SOUTH:
-                if (mob_quad_y < MAP_HEIGHT_QUAD - 1 &&
-                    map_tile_is_passable(mob_quad_x, mob_quad_y + 1)) {
+                if (neighbors & MAP_NEIGHBOR(SOUTH)) {
                     uint8_t d = quad_distance(mob_quad_x, mob_quad_y + 1,
                                               target_quad_x, target_quad_y);
                     if ((toward && d < best_dist) ||
@@ -187,8 +185,7 @@ static void move_relative_quad(bool toward, uint8_t r, uint8_t mob_quad_x,
                 break;
 
             case EAST:
-                if (mob_quad_x < MAP_WIDTH_QUAD - 1 &&
-                    map_tile_is_passable(mob_quad_x + 1, mob_quad_y)) {
+                if (neighbors & MAP_NEIGHBOR(EAST)) {
                     uint16_t d = quad_distance(mob_quad_x + 1, mob_quad_y,
                                                target_quad_x, target_quad_y);
                     if ((toward && d < best_dist) ||
@@ -201,8 +198,7 @@ static void move_relative_quad(bool toward, uint8_t r, uint8_t mob_quad_x,
                 break;
 
             case WEST:
-                if (mob_quad_x > 0 &&
-                    map_tile_is_passable(mob_quad_x - 1, mob_quad_y)) {
+                if (neighbors & MAP_NEIGHBOR(WEST)) {
                     uint16_t d = quad_distance(mob_quad_x - 1, mob_quad_y,
                                                target_quad_x, target_quad_y);
                     if ((toward && d < best_dist) ||
@@ -217,16 +213,43 @@ static void move_relative_quad(bool toward, uint8_t r, uint8_t mob_quad_x,
     }
 }
 
-static void skeleton_reached_target(uint8_t idx) {
+// Moves the quad one step in the direction. Returns false if dir is not a
+// direction (e.g. FLOW_NONE)
+static bool step_quad(uint8_t dir, uint8_t* quad_x, uint8_t* quad_y) {
+    switch (dir) {
+        case NORTH:
+            (*quad_y)--;
+            return true;
+        case SOUTH:
+            (*quad_y)++;
+            return true;
+        case EAST:
+            (*quad_x)++;
+            return true;
+        case WEST:
+            (*quad_x)--;
+            return true;
+    }
+    return false;
+}
+
+void skeleton_reached_target(uint8_t idx) {
     uint8_t mob_quad_x = mob_get_quad_x(idx);
     uint8_t mob_quad_y = mob_get_quad_y(idx);
     uint8_t next_quad_x = mob_quad_x;
     uint8_t next_quad_y = mob_quad_y;
 
+    // Mostly follow the flow field toward the player, so that skeletons find
+    // their way around obstacles
     uint8_t r = rand();
-    if (r & 0xC) {
-        move_relative_quad(true, r, mob_quad_x, mob_quad_y, player_get_quad_x(),
-                           player_get_quad_y(), &next_quad_x, &next_quad_y);
+    uint8_t dir = (r & 0xC) ? flow_get_dir(mob_quad_x, mob_quad_y) : FLOW_NONE;
+    if (step_quad(dir, &next_quad_x, &next_quad_y)) {
+        // Far from the player, keep going if the path is straight so that the
+        // skeleton plans half as often
+        if (mob_get_lod(idx) == MOB_LOD_FAR &&
+            flow_get_dir(next_quad_x, next_quad_y) == dir) {
+            step_quad(dir, &next_quad_x, &next_quad_y);
+        }
     } else {
         random_move(mob_quad_x, mob_quad_y, &next_quad_x, &next_quad_y);
     }
@@ -235,7 +258,7 @@ static void skeleton_reached_target(uint8_t idx) {
                    next_quad_y * QUAD_HEIGHT_PX + QUAD_HEIGHT_PX / 2);
 }
 
-static void skeleton_archer_reached_target(uint8_t idx) {
+void skeleton_archer_reached_target(uint8_t idx) {
     uint8_t mob_quad_x = mob_get_quad_x(idx);
     uint8_t mob_quad_y = mob_get_quad_y(idx);
     uint8_t next_quad_x = mob_quad_x;
@@ -271,7 +294,7 @@ static void skeleton_archer_reached_target(uint8_t idx) {
                    next_quad_y * QUAD_HEIGHT_PX + QUAD_HEIGHT_PX / 2);
 }
 
-static void skeleton_player_collision(uint8_t idx) {
+void skeleton_player_collision(uint8_t idx) {
     enum direction dir = dir_from(mob_get_map_x(idx), mob_get_map_y(idx),
                                   player_map_x, player_map_y);
     switch (dir) {
@@ -292,7 +315,7 @@ static void skeleton_player_collision(uint8_t idx) {
     }
 }
 
-static void arrow_player_collision(uint8_t idx) {
+void arrow_player_collision(uint8_t idx) {
     enum direction dir = arrow_get_direction(idx);
     uint16_t x = mob_get_map_x(idx);
     uint8_t y = mob_get_map_y(idx);
@@ -304,7 +327,7 @@ static void arrow_player_collision(uint8_t idx) {
                 uint8_t arrow_idx = create_blocked_arrow(x, y);
                 if (arrow_idx != MAX_MOBS) {
                     mob_set_target(arrow_idx, x + 5, y + 5);
-                    mob_set_speed(arrow_idx, 1, 2);
+                    mob_set_speed(arrow_idx, MOB_SPEED(1, 2));
                 }
             } else {
                 damage_player_push(1, 0, -1);
@@ -316,7 +339,7 @@ static void arrow_player_collision(uint8_t idx) {
                 uint8_t arrow_idx = create_blocked_arrow(x, y);
                 if (arrow_idx != MAX_MOBS) {
                     mob_set_target(arrow_idx, x + 5, y - 5);
-                    mob_set_speed(arrow_idx, 1, 2);
+                    mob_set_speed(arrow_idx, MOB_SPEED(1, 2));
                 }
             } else {
                 damage_player_push(1, 0, 1);
@@ -328,7 +351,7 @@ static void arrow_player_collision(uint8_t idx) {
                 uint8_t arrow_idx = create_blocked_arrow(x, y);
                 if (arrow_idx != MAX_MOBS) {
                     mob_set_target(arrow_idx, x - 5, y + 5);
-                    mob_set_speed(arrow_idx, 1, 2);
+                    mob_set_speed(arrow_idx, MOB_SPEED(1, 2));
                 }
             } else {
                 damage_player_push(1, 1, 0);
@@ -340,7 +363,7 @@ static void arrow_player_collision(uint8_t idx) {
                 uint8_t arrow_idx = create_blocked_arrow(x, y);
                 if (arrow_idx != MAX_MOBS) {
                     mob_set_target(arrow_idx, x - 5, y + 5);
-                    mob_set_speed(arrow_idx, 1, 2);
+                    mob_set_speed(arrow_idx, MOB_SPEED(1, 2));
                 }
             } else {
                 damage_player_push(1, -1, 0);
@@ -357,101 +380,82 @@ static void shoot_arrow(uint8_t idx, enum direction direction,
         return;
     }
     create_arrow(arrow_idx, mob_get_map_x(idx), mob_get_map_y(idx), direction);
+    mob_set_archetype(arrow_idx, MOB_ARCHETYPE_ENEMY_ARROW);
 
     mob_set_target(arrow_idx, target_x, target_y);
-    mob_set_player_collision_handler(arrow_idx, arrow_player_collision);
 
     // 2 second cool down
-    skeleton_archer.arrow_cool_down[idx] = 100;
+    mob_set_timer(idx, MOB_TIMER_ARCHETYPE, 100, NULL);
 }
 
-static void skeleton_archer_update(uint8_t idx, uint8_t num_frames) {
-    if (skeleton_archer.arrow_cool_down[idx] < num_frames) {
-        skeleton_archer.arrow_cool_down[idx] = 0;
-    } else {
-        skeleton_archer.arrow_cool_down[idx] -= num_frames;
-    }
+// num_frames is not needed since the cool down is a mob timer, but the
+// signature is fixed by mob_update_handler
+void skeleton_archer_update(uint8_t idx, uint8_t num_frames) {
+    (void)num_frames;
 
-    if (skeleton_archer.arrow_cool_down[idx] == 0) {
-        if (SAME_QUAD_X(player_map_x, mob_get_map_x(idx))) {
-            if (player_map_y < mob_get_map_y(idx)) {
-                shoot_arrow(idx, NORTH, mob_get_map_x(idx), 0);
-            } else {
-                shoot_arrow(idx, SOUTH, mob_get_map_x(idx), MAP_HEIGHT_PX);
-            }
-        } else if (SAME_QUAD_Y(player_map_y, mob_get_map_y(idx))) {
-            if (player_map_x < mob_get_map_x(idx)) {
-                shoot_arrow(idx, WEST, 0, mob_get_map_y(idx));
-            } else {
-                shoot_arrow(idx, EAST, MAP_WIDTH_PX, mob_get_map_y(idx));
-            }
-        }
+    // Still cooling down from the last arrow
+    if (mob_has_timer(idx, MOB_TIMER_ARCHETYPE)) {
+        return;
     }
-}
-
-static void on_skeleton_kill(uint8_t idx);
-
-static bool new_skeleton(void) {
-    uint8_t quad_x;
-    uint8_t quad_y;
 
-    uint8_t p;
-    do {
-        p = rand();
-        switch (p & 0x03) {
-            case 0:
-                // North side
-                quad_x = (p >> 2) % MAP_WIDTH_QUAD;
-                quad_y = 0;
-                break;
-
-            case 1:
-                // South side
-                quad_x = (p >> 2) % MAP_WIDTH_QUAD;
-                quad_y = MAP_HEIGHT_QUAD - 1;
-                break;
-
-            case 2:
-                // East side
-                quad_x = MAP_WIDTH_QUAD - 1;
-                quad_y = (p >> 2) % MAP_HEIGHT_QUAD;
-                break;
+    // Only shoot if nothing blocks the line of sight to the player, and aim
+    // at the end of the open segment so that the arrow stops at the obstacle
+    uint8_t quad_x = mob_get_quad_x(idx);
+    uint8_t quad_y = mob_get_quad_y(idx);
+    uint8_t player_quad_x = player_get_quad_x();
+    uint8_t player_quad_y = player_get_quad_y();
+
+    if (quad_x == player_quad_x) {
+        uint8_t segment = map_tile_get_col_segment(quad_x, quad_y);
+        if (segment == MAP_SEGMENT_NONE ||
+            segment != map_tile_get_col_segment(quad_x, player_quad_y)) {
+            return;
+        }
 
-            case 3:
-                // West side
-                quad_x = 0;
-                quad_y = (p >> 2) % MAP_HEIGHT_QUAD;
-                break;
+        struct map_segment const* extent = map_get_col_segment_extent(segment);
+        if (player_quad_y < quad_y) {
+            shoot_arrow(idx, NORTH, mob_get_map_x(idx),
+                        extent->first * QUAD_HEIGHT_PX);
+        } else {
+            shoot_arrow(idx, SOUTH, mob_get_map_x(idx),
+                        (extent->last + 1) * QUAD_HEIGHT_PX);
+        }
+    } else if (quad_y == player_quad_y) {
+        uint8_t segment = map_tile_get_row_segment(quad_x, quad_y);
+        if (segment == MAP_SEGMENT_NONE ||
+            segment != map_tile_get_row_segment(player_quad_x, quad_y)) {
+            return;
         }
-    } while (!map_tile_is_passable(quad_x, quad_y));
 
-    uint16_t x = quad_x * QUAD_WIDTH_PX + QUAD_WIDTH_PX / 2;
-    uint8_t y = quad_y * QUAD_HEIGHT_PX + QUAD_HEIGHT_PX / 2;
+        struct map_segment const* extent = map_get_row_segment_extent(segment);
+        if (player_quad_x < quad_x) {
+            shoot_arrow(idx, WEST, extent->first * QUAD_WIDTH_PX,
+                        mob_get_map_y(idx));
+        } else {
+            shoot_arrow(idx, EAST, (extent->last + 1) * QUAD_WIDTH_PX,
+                        mob_get_map_y(idx));
+        }
+    }
+}
 
-    if (p & 0x0C) {
-        uint8_t idx = create_skeleton(x, y);
+bool spawn_enemy(uint16_t map_x, uint8_t map_y, bool archer) {
+    if (!archer) {
+        uint8_t idx = create_skeleton(map_x, map_y);
         if (idx == MAX_MOBS) {
             return false;
         }
 
-        mob_set_death_handler(idx, on_skeleton_kill);
-        mob_set_target(idx, x, y);
-        mob_set_reached_target_handler(idx, skeleton_reached_target);
-        mob_set_player_collision_handler(idx, skeleton_player_collision);
-        mob_set_speed(idx, 1, 1 + (rand() & 0x3));
+        mob_set_target(idx, map_x, map_y);
+        mob_set_speed(idx, skeleton_speeds[rand() & 0x3]);
 
         skeleton_reached_target(idx);
     } else {
-        uint8_t idx = create_skeleton_archer(x, y);
+        uint8_t idx = create_skeleton_archer(map_x, map_y);
         if (idx == MAX_MOBS) {
             return false;
         }
-        skeleton_archer.arrow_cool_down[idx] = 50;
-        mob_set_death_handler(idx, on_skeleton_kill);
-        mob_set_target(idx, x, y);
-        mob_set_reached_target_handler(idx, skeleton_archer_reached_target);
-        mob_set_player_collision_handler(idx, skeleton_player_collision);
-        mob_set_update_handler(idx, skeleton_archer_update);
+        mob_set_timer(idx, MOB_TIMER_ARCHETYPE, 50, NULL);
+        mob_set_target(idx, map_x, map_y);
 
         skeleton_archer_reached_target(idx);
     }
@@ -459,12 +463,12 @@ static bool new_skeleton(void) {
     return true;
 }
 
-static void on_powerup_kill(uint8_t idx) {
+void on_powerup_kill(uint8_t idx) {
     destroy_mob(idx);
-    new_skeleton();
+    spawn_remove();
 }
 
-static void on_skeleton_kill(uint8_t idx) {
+void on_skeleton_kill(uint8_t idx) {
     uint16_t x = mob_get_map_x(idx);
     uint8_t y = mob_get_map_y(idx);
     destroy_mob(idx);
@@ -472,23 +476,23 @@ static void on_skeleton_kill(uint8_t idx) {
     score = bcd_add_u16(score, BCD8(10));
     score_updated = true;
 
+    // A dropped powerup takes the place of the skeleton in the population
+    // until it is gone
     switch (rand() & 0x3) {
         case 0:
-            idx = create_coin(x, y, BCD8(1));
-            if (idx != MAX_MOBS) {
-                mob_set_death_handler(idx, on_powerup_kill);
+            if (create_coin(x, y, BCD8(1)) == MAX_MOBS) {
+                spawn_remove();
             }
             break;
 
         case 1:
-            idx = create_heart(x, y);
-            if (idx != MAX_MOBS) {
-                mob_set_death_handler(idx, on_powerup_kill);
+            if (create_heart(x, y) == MAX_MOBS) {
+                spawn_remove();
             }
             break;
 
         default:
-            new_skeleton();
+            spawn_remove();
             break;
     }
 }
@@ -624,6 +628,9 @@ static void full_redraw(void) {
 
         VICII_CTRL_1 |= _BV(VICII_DEN_BIT);
         prepare_raster_cmds();
+        // Sprites stay hidden until the game loop draws them
+        sprite_shadow->enable = 0;
+        clear_mob_draws();
         create_status_raster_cmd();
         create_done_raster_cmd();
         finish_raster_cmds();
@@ -638,6 +645,7 @@ void game_loop(void) {
     full_redraw();
 
     uint8_t delay_frame = 0;
+    uint8_t work_frame = frame_count;
 
 #ifdef DEBUG
     uint16_t raster_avg = 0;
@@ -647,10 +655,21 @@ void game_loop(void) {
         // Wait for next frame interrupt
         DEBUG_COLOR(COLOR_BLACK);
 
+        // The frame ends at the done interrupt. If it has already happened
+        // since the work started, the work overran the frame
+        if (frame_count == work_frame) {
+            spawn_report_headroom(raster_lines_per_frame -
+                                  get_raster_elapsed(DONE_INT_LINE));
+        } else {
+            spawn_report_headroom(0);
+        }
+
 #ifdef DEBUG
         uint16_t raster_wait_start = get_raster();
+        raster_telemetry_main_done(raster_wait_start);
 #endif
         frame_wait();
+        work_frame = frame_count;
 #ifdef DEBUG
         uint16_t raster_wait_end = get_raster();
         // There is a chance that we read the raster register right as it
@@ -687,19 +706,23 @@ void game_loop(void) {
         }
 #endif
 
+        // The raster commands and sprite registers are built in the back
+        // bank while the ISR is walking the front bank, so interrupts can stay
+        // enabled
+        DEBUG_COLOR(COLOR_YELLOW);
+        prepare_raster_cmds();
+        // Must be done before any new raster commands are allocated
+        capture_mob_collisions();
+
         DEBUG_COLOR(COLOR_RED);
         draw_player();
 
         DEBUG_COLOR(COLOR_YELLOW);
-        DISABLE_INTERRUPTS() {
-            prepare_raster_cmds();
-            create_status_raster_cmd();
-            draw_mobs();
-            create_done_raster_cmd();
-            finish_raster_cmds();
-        }
-
-        update_sprite_pointers();
+        create_status_raster_cmd();
+        draw_mobs();
+        create_done_raster_cmd();
+        schedule_raster_cmds();
+        finish_raster_cmds();
 
         // Frame non critical. These can be done during the frame since they
         // don't affect graphics
@@ -721,11 +744,9 @@ void game_loop(void) {
                 update_coin_string();
                 update_score_string();
 
-                // Update all MOBS to catch up if processing of callbacks is
-                // behind
-                for (uint8_t i = 0; i < MAX_MOBS; i++) {
-                    update_mobs();
-                }
+                // No tick is run on this frame, so give the mob jobs a larger
+                // budget to catch up if they are behind
+                run_mob_jobs(MOB_JOB_CATCH_UP_LINES);
                 continue;
             }
         } else {
@@ -737,9 +758,11 @@ void game_loop(void) {
 
         DEBUG_COLOR(COLOR_GREEN);
         tick_player();
+        tick_flow(player_get_quad_x(), player_get_quad_y());
 
         DEBUG_COLOR(COLOR_PURPLE);
         tick_mobs();
+        tick_spawns();
 
         if (player_health <= 0 && !player_temp_invulnerable) {
             break;
@@ -777,38 +800,48 @@ void game_loop(void) {
 void load_data(uint8_t device_num, char const* fn, uint8_t* dest) {
     uint8_t buffer[256];
 
-    cbm_k_clall();
-    cbm_k_setnam(fn);
-    cbm_k_setlfs(15, device_num, 2);
-    cbm_k_open();
-    cbm_k_chkin(15);
-    uint8_t i = 0;
-    while (!cbm_k_readst()) {
-        buffer[i] = cbm_k_chrin();
-        i++;
-        if (i == 0) {
-            DISABLE_INTERRUPTS() {
-                ALL_RAM() { memcpy(dest, buffer, sizeof(buffer)); }
+    KERNAL_ROM() {
+        cbm_k_clall();
+        cbm_k_setnam(fn);
+        cbm_k_setlfs(15, device_num, 2);
+        cbm_k_open();
+        cbm_k_chkin(15);
+        uint8_t i = 0;
+        while (!cbm_k_readst()) {
+            buffer[i] = cbm_k_chrin();
+            i++;
+            if (i == 0) {
+                DISABLE_INTERRUPTS() {
+                    ALL_RAM() { memcpy(dest, buffer, sizeof(buffer)); }
+                }
+                dest += sizeof(buffer);
             }
-            dest += sizeof(buffer);
         }
+        DISABLE_INTERRUPTS() {
+            ALL_RAM() { memcpy(dest, buffer, i); }
+        }
+        cbm_k_close(15);
     }
-    DISABLE_INTERRUPTS() {
-        ALL_RAM() { memcpy(dest, buffer, i); }
-    }
-    cbm_k_close(15);
 }
 
 int main() {
     // Blank screen while setting up
     VICII_CTRL_1 &= ~_BV(VICII_DEN_BIT);
 
-    load_data(current_file_dn ? current_file_dn : 8, "GRAPHICS", &video_base);
+    load_data(current_file_dn ? current_file_dn : 8, "GRAPHICS",
+              &graphics_base);
 
     disable_interrupts();
 
-    // Configure interrupts
+    // Configure interrupts. The KERNAL is banked out while the game runs so
+    // that the ISR can be called directly from the hardware vector instead of
+    // going through the KERNAL dispatch. The KERNAL vector is still set for
+    // when it is banked back in to make KERNAL calls
     ISR_VECTOR = isr_handler;
+    ISR_ADDR = isr_irq_entry;
+    NMI_ADDR = isr_nmi;
+    PROCESSOR_PORT = (PROCESSOR_PORT & ~MEMORY_MASK) |
+                     MEMORY_BASIC_OFF_KERNAL_OFF | _BV(MEMORY_IO_BIT);
 
     // Disable all CIA interrupts
     CIA_1_INTERRUPT = 0x7F;
@@ -833,6 +866,7 @@ int main() {
     VICII_CTRL_2 = DEFAULT_VICII_CTRL_2;
     VICII_INTERRUPT_ENABLE = _BV(VICII_RST_BIT);
 
+    init_raster_cmds();
     prepare_raster_cmds();
     create_status_raster_cmd();
     create_done_raster_cmd();
@@ -841,7 +875,15 @@ int main() {
     memset(health_string_buf, ' ', sizeof(health_string_buf) - 1);
     health_string_buf[sizeof(health_string_buf) - 1] = '\0';
 
-    is_ntsc = (detect_video() != VIDEO_PAL_6596);
+    enum video_type video = detect_video();
+    is_ntsc = (video != VIDEO_PAL_6596);
+    // Unknown video types keep the PAL line count, which can only overestimate
+    // the time spent by a raster line budget
+    if (video == VIDEO_NTSC_6567R8) {
+        raster_lines_per_frame = 263;
+    } else if (video == VIDEO_NTSC_6567R65A) {
+        raster_lines_per_frame = 262;
+    }
 
     enable_interrupts();
 
@@ -850,8 +892,11 @@ int main() {
     frame_wait();
 
     while (true) {
-        // Hide all sprites
-        VICII_SPRITE_ENABLE = 0;
+        // Hide all sprites. The ISR reloads the enables from the shadow of the
+        // bank it is showing, so clear them in every bank
+        for (uint8_t i = 0; i < RASTER_NUM_BANKS; i++) {
+            sprite_shadows[i].enable = 0;
+        }
 
         player_map_x = PLAYER_START_X_QUAD * QUAD_WIDTH_PX + QUAD_WIDTH_PX / 2;
         player_map_y =
@@ -867,9 +912,9 @@ int main() {
 
         destroy_all_mobs();
 
-        for (uint8_t i = 0; i < 6; i++) {
-            new_skeleton();
-        }
+        init_flow(player_get_quad_x(), player_get_quad_y());
+
+        init_spawns();
 
         fill_color(START_TEXT_X, START_TEXT_Y,
                    START_TEXT_X + sizeof(start_text), START_TEXT_Y,
@@ -9,6 +9,30 @@ bool map_tile_is_passable(uint8_t x, uint8_t y) {
     return (current_screen->tiles[y][x] & 0x80) != 0;
 }
 
+uint8_t map_tile_get_neighbors(uint8_t x, uint8_t y) {
+    return current_screen->neighbors[y][x];
+}
+
+uint8_t map_tile_get_clearance(uint8_t x, uint8_t y, enum direction dir) {
+    return current_screen->clearance[dir][y][x];
+}
+
+uint8_t map_tile_get_row_segment(uint8_t x, uint8_t y) {
+    return current_screen->row_segments[y][x];
+}
+
+uint8_t map_tile_get_col_segment(uint8_t x, uint8_t y) {
+    return current_screen->col_segments[y][x];
+}
+
+struct map_segment const* map_get_row_segment_extent(uint8_t segment) {
+    return &current_screen->row_segment_extents[segment];
+}
+
+struct map_segment const* map_get_col_segment_extent(uint8_t segment) {
+    return &current_screen->col_segment_extents[segment];
+}
+
 uint8_t map_tile_get_image(uint8_t x, uint8_t y) {
     uint8_t idx = TILE_LEGEND_IDX(current_screen->tiles[y][x]);
     return LEGEND_IMAGE(current_screen->legend[idx]);
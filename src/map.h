@@ -8,6 +8,7 @@
 #include <stdint.h>
 
 #include "reg.h"
+#include "util.h"
 
 // Width of the map in quads
 #define MAP_WIDTH_QUAD (19)
@@ -42,6 +43,11 @@
 #define TILE_IS_PASSABLE(t) ((t) & 0x80)
 #define TILE_LEGEND_IDX(t) ((t) & 0x7F)
 
+// Bit for a direction (an enum direction) in the neighbor mask of a quad. The
+// bit is set if the quad next to it in that direction is passable, and is
+// never set for directions that lead off the map
+#define MAP_NEIGHBOR(dir) (1 << (dir))
+
 #define QUAD_X_TO_PX(x) (MAP_OFFSET_X_PX + ((x) * QUAD_WIDTH_PX))
 #define QUAD_Y_TO_PX(y) (MAP_OFFSET_Y_PX + ((y) * QUAD_WIDTH_PX))
 
@@ -72,17 +78,51 @@ enum {
     MAP_IMAGE_POOL,
 };
 
+struct map_quad {
+    uint8_t x;
+    uint8_t y;
+};
+
+// An open segment is a run of passable quads in a row or column, so there is a
+// clear line of sight between any two quads in the same segment. The first and
+// last are the X of the quads for a row, or the Y for a column
+#define MAP_SEGMENT_NONE (0xFF)
+
+struct map_segment {
+    uint8_t first;
+    uint8_t last;
+};
+
 struct map_screen {
     uint8_t bg_color_0;
     uint8_t bg_color_1;
     uint8_t bg_color_2;
     uint8_t const* legend;
     uint8_t tiles[MAP_HEIGHT_QUAD][MAP_WIDTH_QUAD];
+    uint8_t neighbors[MAP_HEIGHT_QUAD][MAP_WIDTH_QUAD];
+    // The passable quads on the edges of the map, where mobs can spawn
+    struct map_quad const* spawns;
+    uint8_t num_spawns;
+    // The open segment of each quad in its row and its column, or
+    // MAP_SEGMENT_NONE if the quad is impassable
+    uint8_t row_segments[MAP_HEIGHT_QUAD][MAP_WIDTH_QUAD];
+    uint8_t col_segments[MAP_HEIGHT_QUAD][MAP_WIDTH_QUAD];
+    struct map_segment const* row_segment_extents;
+    struct map_segment const* col_segment_extents;
+    // The number of pixels from the edge of each quad to the nearest
+    // impassable quad or edge of the map in each direction, up to 240
+    uint8_t clearance[DIRECTION_COUNT][MAP_HEIGHT_QUAD][MAP_WIDTH_QUAD];
 };
 
 extern const struct map_screen* current_screen;
 
 bool map_tile_is_passable(uint8_t x, uint8_t y);
+uint8_t map_tile_get_neighbors(uint8_t x, uint8_t y);
+uint8_t map_tile_get_clearance(uint8_t x, uint8_t y, enum direction dir);
+uint8_t map_tile_get_row_segment(uint8_t x, uint8_t y);
+uint8_t map_tile_get_col_segment(uint8_t x, uint8_t y);
+struct map_segment const* map_get_row_segment_extent(uint8_t segment);
+struct map_segment const* map_get_col_segment_extent(uint8_t segment);
 uint8_t map_tile_get_image(uint8_t x, uint8_t y);
 uint8_t map_tile_get_color(uint8_t x, uint8_t y);
 
@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "draw.h"
 #include "isr.h"
 #include "map.h"
 #include "move.h"
@@ -18,15 +19,29 @@
 
 #define FRAMES(f) ARRAY_SIZE(f), f
 
-#define MOB_SPRITE_OFFSET (2)
-#define NUM_MOB_SPRITES (8 - MOB_SPRITE_OFFSET)
 #define DAMAGE_PUSH (3)
+#define DAMAGE_TICKS (5)
+// Ticks between toggling the sprite of a mob that is blinking before it dies.
+// This is a fixed rate, where power ups used to toggle on each of their
+// updates. The lifetime and blink time of an archetype are also in ticks, so
+// they run longer when the game is slowed by dropped frames
+#define MOB_BLINK_TICKS (8)
+
+// Fully unrolling the multiplexed sprites is only worth the code size while
+// each hardware sprite is reused at most once
+#if MAX_MOBS <= 2 * NUM_MOB_SPRITES
+#define MULTIPLEX_LOOP_UNROLL _Pragma("clang loop unroll(full)")
+#else
+#define MULTIPLEX_LOOP_UNROLL
+#endif
 
 #define MOB_FLAG_IN_USE _BV(0)
 #define MOB_FLAG_REACHED_TARGET _BV(1)
 #define MOB_FLAG_HAS_SPRITE _BV(2)
 #define MOB_FLAG_HOSTILE _BV(3)
 #define MOB_FLAG_HAS_TARGET _BV(4)
+#define MOB_FLAG_JOB_QUEUED _BV(5)
+#define MOB_FLAG_DAMAGED _BV(6)
 
 #define mob_check_flag(idx, _flag) (mobs_flags[idx] & MOB_FLAG_##_flag)
 #define mob_set_flag(idx, _flag) (mobs_flags[idx] |= MOB_FLAG_##_flag)
@@ -46,8 +61,42 @@
 #define mob_clr_handler_flag(idx, _handler) \
     (mobs_handler_flags[idx] &= ~(MOB_HANDLER_FLAG_##_handler))
 
+// Once an update has waited twice as long as its interval, it is run ahead of
+// the reached target jobs so that it can not be starved. The reached target
+// jobs of far mobs are run ahead of everything once they have waited this many
+// ticks
+#define MOB_JOB_MAX_WAIT (25)
+
 static uint8_t mob_update_idx = 0;
 
+// Reached target jobs are run in the order the mobs reached their targets, with
+// a queue for each level of detail. Each mob has at most one job queued, but a
+// destroyed mob leaves its job behind (to be skipped when its handle is found
+// to be stale) so there is room for twice as many. If the queue is full, the
+// mob tries again on the next tick
+#define MOB_JOB_QUEUE_SIZE (2 * MAX_MOBS)
+
+struct mob_job_queue {
+    mob_handle handle[MOB_JOB_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t count;
+};
+
+static struct mob_job_queue mob_jobs[MOB_LOD_COUNT];
+
+static const struct mob_archetype* const mob_archetypes[MOB_ARCHETYPE_COUNT] = {
+    [MOB_ARCHETYPE_SKELETON] = &skeleton_archetype,
+    [MOB_ARCHETYPE_SKELETON_ARCHER] = &skeleton_archer_archetype,
+    [MOB_ARCHETYPE_COIN] = &coin_archetype,
+    [MOB_ARCHETYPE_HEART] = &heart_archetype,
+    [MOB_ARCHETYPE_ARROW] = &arrow_archetype,
+    [MOB_ARCHETYPE_PLAYER_ARROW] = &player_arrow_archetype,
+    [MOB_ARCHETYPE_ENEMY_ARROW] = &enemy_arrow_archetype,
+    [MOB_ARCHETYPE_BLOCKED_ARROW] = &blocked_arrow_archetype,
+};
+
+#define mob_get_archetype(idx) (mob_archetypes[mobs_archetype[idx]])
+
 static uint8_t mobs_flags[MAX_MOBS] = {0};
 static uint8_t mobs_handler_flags[MAX_MOBS];
 static struct sprite const* mobs_sprite[MAX_MOBS];
@@ -65,41 +114,320 @@ static uint16_t mobs_map_x[MAX_MOBS];
 static uint8_t mobs_map_y[MAX_MOBS];
 static uint8_t mobs_bot_y[MAX_MOBS];
 static int8_t mobs_hp[MAX_MOBS];
-static uint8_t mobs_color[MAX_MOBS];
-static uint8_t mobs_damage_color[MAX_MOBS];
-static uint8_t mobs_damage_counter[MAX_MOBS];
-static uint8_t mobs_speed_pixels[MAX_MOBS];
-static uint8_t mobs_speed_frames[MAX_MOBS];
+static uint8_t mobs_blink_ticks[MAX_MOBS];
+static uint16_t mobs_speed[MAX_MOBS];
 static uint16_t mobs_target_map_x[MAX_MOBS];
 static uint8_t mobs_target_map_y[MAX_MOBS];
 static int8_t mobs_damage_push_x[MAX_MOBS];
 static int8_t mobs_damage_push_y[MAX_MOBS];
 static uint8_t mobs_sprite_frame[MAX_MOBS];
-static uint8_t mobs_animation_rate[MAX_MOBS];
 static uint8_t mobs_animation_count[MAX_MOBS];
-static mob_weapon_collision_handler mobs_on_weapon_collision[MAX_MOBS];
-static mob_action_handler mobs_on_player_collision[MAX_MOBS];
-static mob_action_handler mobs_on_death[MAX_MOBS];
-static mob_action_handler mobs_on_reached_target[MAX_MOBS];
-static mob_update_handler mobs_on_update[MAX_MOBS];
-static mob_mob_collision_handler mobs_on_mob_collision[MAX_MOBS];
-static uint8_t mobs_speed_counter[MAX_MOBS];
+static uint8_t mobs_archetype[MAX_MOBS];
+// Movement toward the target. The velocity is in 1/256ths of a pixel per tick
+// and is worked out when the target is set
+static int16_t mobs_velocity_x[MAX_MOBS];
+static int16_t mobs_velocity_y[MAX_MOBS];
+static uint8_t mobs_subpixel_x[MAX_MOBS];
+static uint8_t mobs_subpixel_y[MAX_MOBS];
+static uint16_t mobs_move_ticks[MAX_MOBS];
 static uint8_t mobs_last_update_tick[MAX_MOBS];
-
+static uint8_t mobs_update_ticks[MAX_MOBS];
+static uint8_t mobs_lod[MAX_MOBS];
+static uint8_t mobs_job_tick[MAX_MOBS];
+static union mob_payload mobs_payload[MAX_MOBS];
+
+// Timer wheel. Each mob has one of each kind of timer, so a timer is node
+// timer * MAX_MOBS + idx. The nodes that expire on a tick are in a doubly
+// linked list in the bucket for that tick. A bucket is visited every
+// MOB_TIMER_WHEEL_SIZE ticks, so the expiry tick of each node is checked to
+// allow delays longer than that
+#define MOB_TIMER_WHEEL_SIZE (64)
+#define MOB_NUM_TIMERS (MOB_TIMER_COUNT * MAX_MOBS)
+#define MOB_TIMER_NONE (0xFF)
+_Static_assert(MOB_NUM_TIMERS < MOB_TIMER_NONE, "Too many mob timers");
+// Bucket that holds the timers being fired
+#define MOB_TIMER_FIRING (MOB_TIMER_WHEEL_SIZE)
+
+static uint8_t mob_timer_wheel[MOB_TIMER_WHEEL_SIZE + 1];
+static uint8_t mob_timer_next[MOB_NUM_TIMERS];
+static uint8_t mob_timer_prev[MOB_NUM_TIMERS];
+// MOB_TIMER_NONE when the timer is not running
+static uint8_t mob_timer_bucket[MOB_NUM_TIMERS];
+static uint8_t mob_timer_expire[MOB_NUM_TIMERS];
+static mob_action_handler mob_timer_handler[MOB_NUM_TIMERS];
+
+// Mob indexes sorted by bottom Y, with the hidden mobs (bottom Y of 0xFF) at
+// the end, and the position of each mob in it
 static uint8_t mob_idx_by_y[MAX_MOBS];
+static uint8_t mobs_y_order_pos[MAX_MOBS];
+// Number of mobs at the start of mob_idx_by_y that are not hidden
+static uint8_t mob_num_visible;
+
+// Singly linked list of free slots for each class
+#define MOB_FREE_NONE (0xFF)
+
+static uint8_t mobs_generation[MAX_MOBS];
+static uint8_t mobs_next_free[MAX_MOBS];
+static uint8_t mob_free_head[MOB_CLASS_COUNT];
+static uint8_t mob_free_tail[MOB_CLASS_COUNT];
+
+struct mob_list mobs_active;
+struct mob_list mobs_mob_collision;
+
+// Which lists each mob is currently in, so that it is never added twice
+#define MOB_LISTED_ACTIVE _BV(0)
+#define MOB_LISTED_MOB_COLLISION _BV(1)
+
+static uint8_t mobs_listed[MAX_MOBS];
+
+static struct mob_list mobs_query;
+
+// Hardware sprite and range of raster commands that each mob was drawn with in
+// each bank of raster commands. This is used to work out which mobs the sprite
+// collisions latched by the ISR belong to. A sprite mask of 0 means the mob was
+// not drawn
+static uint8_t mobs_draw_sprite_mask[RASTER_NUM_BANKS][MAX_MOBS];
+static uint8_t mobs_draw_first_cmd[RASTER_NUM_BANKS][MAX_MOBS];
+static uint8_t mobs_draw_last_cmd[RASTER_NUM_BANKS][MAX_MOBS];
+
+// What the sprite of each mob collided with in the last displayed frame. If
+// this can't be determined, all of the bits are set so that the bounding box
+// checks are always done
+#define MOB_SPRITE_COLLISION_WEAPON _BV(0)
+#define MOB_SPRITE_COLLISION_PLAYER _BV(1)
+#define MOB_SPRITE_COLLISION_MOB _BV(2)
+#define MOB_SPRITE_COLLISION_UNKNOWN (0xFF)
+
+static uint8_t mobs_sprite_collisions[MAX_MOBS];
+
+static enum mob_class mob_get_class(uint8_t idx) {
+    if (idx >= MOB_CLASS_PLAYER_PROJECTILE_FIRST) {
+        return MOB_CLASS_PLAYER_PROJECTILE;
+    }
+    return MOB_CLASS_GENERAL;
+}
+
+// Freed slots go on the end of the list so that a slot is not reused straight
+// away while a caller might still be looking at the mob that was in it
+static void push_free_mob(uint8_t idx) {
+    enum mob_class mob_class = mob_get_class(idx);
+
+    mobs_next_free[idx] = MOB_FREE_NONE;
+    if (mob_free_head[mob_class] == MOB_FREE_NONE) {
+        mob_free_head[mob_class] = idx;
+    } else {
+        mobs_next_free[mob_free_tail[mob_class]] = idx;
+    }
+    mob_free_tail[mob_class] = idx;
+}
+
+static void mob_list_add(struct mob_list* list, uint8_t idx, uint8_t listed) {
+    if (mobs_listed[idx] & listed) {
+        return;
+    }
+    mobs_listed[idx] |= listed;
+    list->idx[list->count++] = idx;
+}
+
+// Removes the mobs that are no longer in use, or no longer have the handler
+// flag (if not 0) from a list
+static void mob_list_compact(struct mob_list* list, uint8_t listed,
+                             uint8_t handler_flag) {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < list->count; i++) {
+        uint8_t idx = list->idx[i];
+        if (mob_check_flag(idx, IN_USE) &&
+            (!handler_flag || (mobs_handler_flags[idx] & handler_flag))) {
+            list->idx[count++] = idx;
+        } else {
+            mobs_listed[idx] &= ~listed;
+        }
+    }
+    list->count = count;
+}
+
+static void compact_mob_lists(void) {
+    mob_list_compact(&mobs_active, MOB_LISTED_ACTIVE, 0);
+    mob_list_compact(&mobs_mob_collision, MOB_LISTED_MOB_COLLISION,
+                     MOB_HANDLER_FLAG_MOB_COLLISION);
+}
+
+static void link_mob_timer(uint8_t node, uint8_t bucket) {
+    uint8_t head = mob_timer_wheel[bucket];
+
+    mob_timer_bucket[node] = bucket;
+    mob_timer_prev[node] = MOB_TIMER_NONE;
+    mob_timer_next[node] = head;
+    if (head != MOB_TIMER_NONE) {
+        mob_timer_prev[head] = node;
+    }
+    mob_timer_wheel[bucket] = node;
+}
+
+static void unlink_mob_timer(uint8_t node) {
+    uint8_t prev = mob_timer_prev[node];
+    uint8_t next = mob_timer_next[node];
+
+    if (prev == MOB_TIMER_NONE) {
+        mob_timer_wheel[mob_timer_bucket[node]] = next;
+    } else {
+        mob_timer_next[prev] = next;
+    }
+    if (next != MOB_TIMER_NONE) {
+        mob_timer_prev[next] = prev;
+    }
+    mob_timer_bucket[node] = MOB_TIMER_NONE;
+}
+
+// Calls the handler for the mob after the number of ticks (at least 1),
+// replacing the timer if it is already running. The timers of a mob are
+// stopped when it is destroyed
+void mob_set_timer(uint8_t idx, enum mob_timer timer, uint8_t ticks,
+                   mob_action_handler handler) {
+    uint8_t node = timer * MAX_MOBS + idx;
+    uint8_t expire;
+
+    if (mob_timer_bucket[node] != MOB_TIMER_NONE) {
+        unlink_mob_timer(node);
+    }
+
+    if (ticks == 0) {
+        ticks = 1;
+    }
+    expire = tick_count + ticks;
+    mob_timer_expire[node] = expire;
+    mob_timer_handler[node] = handler;
+    link_mob_timer(node, expire & (MOB_TIMER_WHEEL_SIZE - 1));
+}
+
+void mob_clr_timer(uint8_t idx, enum mob_timer timer) {
+    uint8_t node = timer * MAX_MOBS + idx;
+
+    if (mob_timer_bucket[node] != MOB_TIMER_NONE) {
+        unlink_mob_timer(node);
+    }
+}
+
+bool mob_has_timer(uint8_t idx, enum mob_timer timer) {
+    return mob_timer_bucket[timer * MAX_MOBS + idx] != MOB_TIMER_NONE;
+}
+
+static void tick_mob_timers(void) {
+    uint8_t node = mob_timer_wheel[tick_count & (MOB_TIMER_WHEEL_SIZE - 1)];
+
+    // The expired timers are moved to their own list before any handlers are
+    // called, since a handler can stop or start any of the timers
+    while (node != MOB_TIMER_NONE) {
+        uint8_t next = mob_timer_next[node];
+        if (mob_timer_expire[node] == tick_count) {
+            unlink_mob_timer(node);
+            link_mob_timer(node, MOB_TIMER_FIRING);
+        }
+        node = next;
+    }
+
+    while ((node = mob_timer_wheel[MOB_TIMER_FIRING]) != MOB_TIMER_NONE) {
+        unlink_mob_timer(node);
+        if (mob_timer_handler[node]) {
+            // The nodes of each timer follow each other, so the mob index is
+            // found without a (slow) division
+            uint8_t idx = node;
+            while (idx >= MAX_MOBS) {
+                idx -= MAX_MOBS;
+            }
+            mob_timer_handler[node](idx);
+        }
+    }
+}
+
+static void mob_blink(uint8_t idx) {
+    if (mobs_blink_ticks[idx] <= MOB_BLINK_TICKS) {
+        kill_mob(idx);
+        return;
+    }
+
+    mobs_blink_ticks[idx] -= MOB_BLINK_TICKS;
+    mob_set_sprite(idx,
+                   mob_has_sprite(idx) ? NULL : mob_get_archetype(idx)->sprite);
+    mob_set_timer(idx, MOB_TIMER_ARCHETYPE, MOB_BLINK_TICKS, mob_blink);
+}
+
+static void mob_lifetime_end(uint8_t idx) {
+    mobs_blink_ticks[idx] = mob_get_archetype(idx)->blink_ticks;
+    mob_blink(idx);
+}
+
+static void mob_damage_end(uint8_t idx) {
+    mob_clr_flag(idx, DAMAGED);
+    if (mobs_hp[idx] <= 0) {
+        kill_mob(idx);
+    }
+}
 
 void init_mobs(void) {
+    for (uint8_t i = 0; i < MOB_CLASS_COUNT; i++) {
+        mob_free_head[i] = MOB_FREE_NONE;
+    }
+
+    memset(mob_timer_wheel, MOB_TIMER_NONE, sizeof(mob_timer_wheel));
+    memset(mob_timer_bucket, MOB_TIMER_NONE, sizeof(mob_timer_bucket));
+
     for (uint8_t i = 0; i < MAX_MOBS; i++) {
         mobs_bot_y[i] = 0xFF;
         mob_idx_by_y[i] = i;
+        mobs_y_order_pos[i] = i;
+        push_free_mob(i);
+    }
+}
+
+// Moves a mob to its place in mob_idx_by_y after its bottom Y has changed.
+// Mobs only move a few pixels at a time, so this usually only has to step past
+// a neighbor or two instead of sorting the whole list
+static void update_mob_y_order(uint8_t idx) {
+    uint8_t pos = mobs_y_order_pos[idx];
+    uint8_t bot_y = mobs_bot_y[idx];
+
+    while (pos > 0) {
+        uint8_t prev_idx = mob_idx_by_y[pos - 1];
+        if (mobs_bot_y[prev_idx] <= bot_y) {
+            break;
+        }
+        mob_idx_by_y[pos] = prev_idx;
+        mobs_y_order_pos[prev_idx] = pos;
+        pos--;
+    }
+
+    while (pos < MAX_MOBS - 1) {
+        uint8_t next_idx = mob_idx_by_y[pos + 1];
+        if (mobs_bot_y[next_idx] >= bot_y) {
+            break;
+        }
+        mob_idx_by_y[pos] = next_idx;
+        mobs_y_order_pos[next_idx] = pos;
+        pos++;
+    }
+
+    mob_idx_by_y[pos] = idx;
+    mobs_y_order_pos[idx] = pos;
+}
+
+static void set_mob_bot_y(uint8_t idx, uint8_t bot_y) {
+    if (mobs_bot_y[idx] != bot_y) {
+        if (mobs_bot_y[idx] == 0xFF) {
+            mob_num_visible++;
+        } else if (bot_y == 0xFF) {
+            mob_num_visible--;
+        }
+        mobs_bot_y[idx] = bot_y;
+        update_mob_y_order(idx);
     }
 }
 
 static void set_bot_y(uint8_t idx) {
     if (mob_check_flag(idx, HAS_SPRITE)) {
-        mobs_bot_y[idx] = mob_get_y(idx) + SPRITE_HEIGHT_PX;
+        set_mob_bot_y(idx, mob_get_y(idx) + SPRITE_HEIGHT_PX);
     } else {
-        mobs_bot_y[idx] = 0xFF;
+        set_mob_bot_y(idx, 0xFF);
     }
 }
 
@@ -125,24 +453,60 @@ static uint8_t clamp_map_y(uint8_t map_y) {
     return map_y;
 }
 
-// Ocean sort method
-static void sort_mobs_y(void) {
-    for (uint8_t i = 0; i < MAX_MOBS - 1; i++) {
-        if (mobs_bot_y[mob_idx_by_y[i + 1]] < mobs_bot_y[mob_idx_by_y[i]]) {
-            uint8_t j = i;
-            while (true) {
-                swap(mob_idx_by_y[j], mob_idx_by_y[j + 1]);
-                if (j == 0) {
-                    break;
-                }
-                j--;
-                if (mobs_bot_y[mob_idx_by_y[j + 1]] >=
-                    mobs_bot_y[mob_idx_by_y[j]]) {
-                    break;
-                }
-            }
-        }
+// Works out the velocity that moves a mob in a straight line to its target.
+// The axis with the furthest to go moves at the speed of the mob. The mob is
+// put exactly on the target after the last tick, so the rounding of the
+// velocity does not build up
+static void mob_calc_velocity(uint8_t idx) {
+    uint16_t speed = mobs_speed[idx];
+    uint16_t dist_x;
+    uint8_t dist_y;
+    uint16_t dist;
+
+    mobs_subpixel_x[idx] = 0x80;
+    mobs_subpixel_y[idx] = 0x80;
+
+    if (speed == 0) {
+        // Never gets there
+        mobs_move_ticks[idx] = 0;
+        return;
+    }
+
+    if (mobs_target_map_x[idx] >= mobs_map_x[idx]) {
+        dist_x = mobs_target_map_x[idx] - mobs_map_x[idx];
+    } else {
+        dist_x = mobs_map_x[idx] - mobs_target_map_x[idx];
+    }
+
+    if (mobs_target_map_y[idx] >= mobs_map_y[idx]) {
+        dist_y = mobs_target_map_y[idx] - mobs_map_y[idx];
+    } else {
+        dist_y = mobs_map_y[idx] - mobs_target_map_y[idx];
+    }
+
+    dist = dist_x > dist_y ? dist_x : dist_y;
+    if (dist == 0) {
+        // Already there, so reach the target on the next tick
+        mobs_velocity_x[idx] = 0;
+        mobs_velocity_y[idx] = 0;
+        mobs_move_ticks[idx] = 1;
+        return;
     }
+
+    uint16_t ticks = (((uint32_t)dist << 8) + speed - 1) / speed;
+    int16_t velocity_x = (((uint32_t)dist_x << 8) + ticks / 2) / ticks;
+    int16_t velocity_y = (((uint32_t)dist_y << 8) + ticks / 2) / ticks;
+
+    if (mobs_target_map_x[idx] < mobs_map_x[idx]) {
+        velocity_x = -velocity_x;
+    }
+    if (mobs_target_map_y[idx] < mobs_map_y[idx]) {
+        velocity_y = -velocity_y;
+    }
+
+    mobs_velocity_x[idx] = velocity_x;
+    mobs_velocity_y[idx] = velocity_y;
+    mobs_move_ticks[idx] = ticks;
 }
 
 void mob_set_sprite(uint8_t idx, struct sprite const* sprite) {
@@ -172,6 +536,9 @@ void mob_set_position(uint8_t idx, uint16_t map_x, uint8_t map_y) {
     mobs_map_y[idx] = clamp_map_y(map_y);
     set_bot_y(idx);
     mob_calc_bb16(idx);
+    if (mob_check_flag(idx, HAS_TARGET)) {
+        mob_calc_velocity(idx);
+    }
 }
 
 uint16_t mob_get_x(uint8_t idx) {
@@ -190,111 +557,132 @@ uint8_t mob_get_quad_y(uint8_t idx) { return mobs_map_y[idx] / QUAD_HEIGHT_PX; }
 
 void mob_set_hp(uint8_t idx, int8_t hp) { mobs_hp[idx] = hp; }
 
-void mob_set_color(uint8_t idx, uint8_t color) { mobs_color[idx] = color; }
-
-void mob_set_damage_color(uint8_t idx, uint8_t color) {
-    mobs_damage_color[idx] = color;
-}
-
-void mob_set_speed(uint8_t idx, uint8_t speed_pixels, uint8_t speed_frames) {
-    mobs_speed_pixels[idx] = speed_pixels;
-    mobs_speed_frames[idx] = speed_frames;
+void mob_set_speed(uint8_t idx, uint16_t speed) {
+    mobs_speed[idx] = speed;
+    if (mob_check_flag(idx, HAS_TARGET)) {
+        mob_calc_velocity(idx);
+    }
 }
 
-void mob_set_target(uint8_t idx, uint16_t map_x, uint8_t map_y) {
-    mobs_target_map_x[idx] = map_x;
-    mobs_target_map_y[idx] = clamp_map_y(map_y);
-    mob_set_flag(idx, HAS_TARGET);
-}
+static void update_mob_lod(uint8_t idx, uint8_t player_quad_x,
+                           uint8_t player_quad_y) {
+    struct mob_lod_tiers const* lod = mob_get_archetype(idx)->lod;
+    uint8_t quad_x;
+    uint8_t quad_y;
 
-uint8_t mob_has_weapon_collision(uint8_t idx) {
-    return mob_check_handler_flag(idx, WEAPON_COLLISION);
-}
+    if (!lod) {
+        mobs_lod[idx] = MOB_LOD_NEAR;
+        mobs_update_ticks[idx] = MOB_UPDATE_TICKS;
+        return;
+    }
 
-void mob_set_weapon_collision_handler(uint8_t idx,
-                                      mob_weapon_collision_handler handler) {
-    mobs_on_weapon_collision[idx] = handler;
-    if (handler) {
-        mob_set_handler_flag(idx, WEAPON_COLLISION);
+    quad_x = mob_get_quad_x(idx);
+    quad_y = mob_get_quad_y(idx);
+    if ((quad_x > player_quad_x ? quad_x - player_quad_x
+                                : player_quad_x - quad_x) >= lod->far_quads ||
+        (quad_y > player_quad_y ? quad_y - player_quad_y
+                                : player_quad_y - quad_y) >= lod->far_quads) {
+        mobs_lod[idx] = MOB_LOD_FAR;
     } else {
-        mob_clr_handler_flag(idx, WEAPON_COLLISION);
+        mobs_lod[idx] = MOB_LOD_NEAR;
     }
+    mobs_update_ticks[idx] = lod->update_ticks[mobs_lod[idx]];
 }
 
-void mob_trigger_weapon_collision(uint8_t idx, uint8_t damage,
-                                  enum direction dir) {
-    if (mob_check_handler_flag(idx, WEAPON_COLLISION)) {
-        mobs_on_weapon_collision[idx](idx, damage, dir);
+enum mob_lod mob_get_lod(uint8_t idx) { return mobs_lod[idx]; }
+
+union mob_payload* mob_get_payload(uint8_t idx, enum mob_payload_kind kind) {
+#ifdef DEBUG
+    // Stop with a flashing border so that the mismatch can be found from the
+    // monitor
+    if (mob_get_archetype(idx)->payload != kind) {
+        disable_interrupts();
+        while (true) {
+            VICII_BORDER_COLOR++;
+        }
     }
+#endif
+    return &mobs_payload[idx];
 }
 
-uint8_t mob_is_hostile(uint8_t idx) { return mob_check_flag(idx, HOSTILE); }
+void mob_set_archetype(uint8_t idx, enum mob_archetype_id id) {
+    const struct mob_archetype* archetype = mob_archetypes[id];
+    uint8_t handler_flags = 0;
 
-void mob_set_hostile(uint8_t idx, bool hostile) {
-    if (hostile) {
+    mobs_archetype[idx] = id;
+
+    if (archetype->on_player_collision) {
+        handler_flags |= MOB_HANDLER_FLAG_PLAYER_COLLISION;
+    }
+    if (archetype->on_weapon_collision) {
+        handler_flags |= MOB_HANDLER_FLAG_WEAPON_COLLISION;
+    }
+    if (archetype->on_death) {
+        handler_flags |= MOB_HANDLER_FLAG_DEATH;
+    }
+    if (archetype->on_reached_target) {
+        handler_flags |= MOB_HANDLER_FLAG_REACHED_TARGET;
+    }
+    if (archetype->on_update) {
+        handler_flags |= MOB_HANDLER_FLAG_UPDATE;
+    }
+    if (archetype->on_mob_collision) {
+        handler_flags |= MOB_HANDLER_FLAG_MOB_COLLISION;
+        mob_list_add(&mobs_mob_collision, idx, MOB_LISTED_MOB_COLLISION);
+    }
+    mobs_handler_flags[idx] = handler_flags;
+
+    update_mob_lod(idx, player_get_quad_x(), player_get_quad_y());
+
+    if (archetype->hostile) {
         mob_set_flag(idx, HOSTILE);
     } else {
         mob_clr_flag(idx, HOSTILE);
     }
 }
 
-uint8_t mob_has_player_collision(uint8_t idx) {
-    return mob_check_handler_flag(idx, PLAYER_COLLISION);
-}
+void mob_init_archetype(uint8_t idx, enum mob_archetype_id id) {
+    const struct mob_archetype* archetype = mob_archetypes[id];
 
-void mob_set_player_collision_handler(uint8_t idx, mob_action_handler handler) {
-    mobs_on_player_collision[idx] = handler;
-    if (handler) {
-        mob_set_handler_flag(idx, PLAYER_COLLISION);
-    } else {
-        mob_clr_handler_flag(idx, PLAYER_COLLISION);
-    }
-}
+    mob_set_archetype(idx, id);
+    mob_set_sprite(idx, archetype->sprite);
+    mob_set_bb(idx, *archetype->bb);
+    mobs_hp[idx] = archetype->hp;
+    mobs_speed[idx] = archetype->speed;
 
-void mob_trigger_player_collision(uint8_t idx) {
-    if (mob_check_handler_flag(idx, PLAYER_COLLISION)) {
-        mobs_on_player_collision[idx](idx);
+    if (archetype->lifetime_ticks) {
+        mob_set_timer(idx, MOB_TIMER_ARCHETYPE, archetype->lifetime_ticks,
+                      mob_lifetime_end);
     }
 }
 
-void mob_set_death_handler(uint8_t idx, mob_action_handler handler) {
-    mobs_on_death[idx] = handler;
-    if (handler) {
-        mob_set_handler_flag(idx, DEATH);
-    } else {
-        mob_clr_handler_flag(idx, DEATH);
-    }
+void mob_set_target(uint8_t idx, uint16_t map_x, uint8_t map_y) {
+    mobs_target_map_x[idx] = map_x;
+    mobs_target_map_y[idx] = clamp_map_y(map_y);
+    mob_set_flag(idx, HAS_TARGET);
+    mob_calc_velocity(idx);
 }
 
-void mob_set_reached_target_handler(uint8_t idx, mob_action_handler handler) {
-    mobs_on_reached_target[idx] = handler;
-    if (handler) {
-        mob_set_handler_flag(idx, REACHED_TARGET);
-    } else {
-        mob_clr_handler_flag(idx, REACHED_TARGET);
-    }
+uint8_t mob_has_weapon_collision(uint8_t idx) {
+    return mob_check_handler_flag(idx, WEAPON_COLLISION);
 }
 
-void mob_set_update_handler(uint8_t idx, mob_update_handler handler) {
-    mobs_on_update[idx] = handler;
-    if (handler) {
-        mob_set_handler_flag(idx, UPDATE);
-    } else {
-        mob_clr_handler_flag(idx, UPDATE);
+void mob_trigger_weapon_collision(uint8_t idx, uint8_t damage,
+                                  enum direction dir) {
+    if (mob_check_handler_flag(idx, WEAPON_COLLISION)) {
+        mob_get_archetype(idx)->on_weapon_collision(idx, damage, dir);
     }
 }
 
-void mob_set_animation_rate(uint8_t idx, uint8_t frames) {
-    mobs_animation_rate[idx] = frames;
+uint8_t mob_is_hostile(uint8_t idx) { return mob_check_flag(idx, HOSTILE); }
+
+uint8_t mob_has_player_collision(uint8_t idx) {
+    return mob_check_handler_flag(idx, PLAYER_COLLISION);
 }
 
-void mob_set_mob_collision_handler(uint8_t idx,
-                                   mob_mob_collision_handler handler) {
-    mobs_on_mob_collision[idx] = handler;
-    if (handler) {
-        mob_set_handler_flag(idx, MOB_COLLISION);
-    } else {
-        mob_clr_handler_flag(idx, MOB_COLLISION);
+void mob_trigger_player_collision(uint8_t idx) {
+    if (mob_check_handler_flag(idx, PLAYER_COLLISION)) {
+        mob_get_archetype(idx)->on_player_collision(idx);
     }
 }
 
@@ -312,77 +700,79 @@ static void mob_inc_y(uint8_t idx, int8_t delta) {
 
 uint8_t mob_in_use(uint8_t idx) { return mob_check_flag(idx, IN_USE); }
 
-uint8_t alloc_mob(void) {
-    for (uint8_t i = 0; i < MAX_MOBS - RESERVED_MOBS; i++) {
-        if (alloc_mob_idx(i)) {
-            return i;
-        }
-    }
-    return MAX_MOBS;
-}
+uint8_t alloc_mob(void) { return alloc_mob_class(MOB_CLASS_GENERAL); }
 
-bool alloc_mob_idx(uint8_t idx) {
-    if (mob_check_flag(idx, IN_USE)) {
-        return false;
+uint8_t alloc_mob_class(enum mob_class mob_class) {
+    uint8_t idx = mob_free_head[mob_class];
+    if (idx == MOB_FREE_NONE) {
+        return MAX_MOBS;
     }
+    mob_free_head[mob_class] = mobs_next_free[idx];
+
+    // Only the state that is read before the creator gets a chance to set it
+    // is reset here. Every creator starts from an archetype with
+    // mob_init_archetype() and then sets the position, and the target and
+    // damage push are ignored until their flags are set
     mobs_flags[idx] = MOB_FLAG_IN_USE;
     mobs_handler_flags[idx] = 0;
 
-    mobs_sprite[idx] = NULL;
-    mobs_bb_north[idx] = 0;
-    mobs_bb_south[idx] = SPRITE_HEIGHT_PX - 1;
-    mobs_bb_east[idx] = SPRITE_WIDTH_PX - 1;
-    mobs_bb_west[idx] = 0;
-    mobs_map_x[idx] = 0;
-    mobs_map_y[idx] = 0;
-    mobs_bot_y[idx] = 0xFF;
-    mobs_hp[idx] = 0;
-    mobs_color[idx] = 0;
-    mobs_damage_color[idx] = 0;
-    mobs_damage_counter[idx] = 0;
-
-    mobs_speed_pixels[idx] = 0;
-    mobs_speed_frames[idx] = 0;
-
-    mobs_target_map_x[idx] = 0;
-    mobs_target_map_y[idx] = 0;
+    set_mob_bot_y(idx, 0xFF);
 
-    mobs_damage_push_x[idx] = 0;
-    mobs_damage_push_y[idx] = 0;
+    mobs_last_update_tick[idx] = tick_count;
+    memset(&mobs_payload[idx], 0, sizeof(mobs_payload[idx]));
 
-    mobs_sprite_frame[idx] = 0;
+    // Any collisions latched for this index belong to the previous mob
+    for (uint8_t bank = 0; bank < RASTER_NUM_BANKS; bank++) {
+        mobs_draw_sprite_mask[bank][idx] = 0;
+    }
+    mobs_sprite_collisions[idx] = MOB_SPRITE_COLLISION_UNKNOWN;
 
-    mobs_on_weapon_collision[idx] = NULL;
-    mobs_on_player_collision[idx] = NULL;
-    mobs_on_death[idx] = NULL;
-    mobs_on_reached_target[idx] = NULL;
-    mobs_on_update[idx] = NULL;
+    mob_list_add(&mobs_active, idx, MOB_LISTED_ACTIVE);
+    return idx;
+}
 
-    mobs_speed_counter[idx] = 1;
-    mobs_last_update_tick[idx] = tick_count;
-    mob_calc_bb16(idx);
-    return true;
+mob_handle mob_get_handle(uint8_t idx) {
+    return ((mob_handle)mobs_generation[idx] << 8) | idx;
+}
+
+uint8_t mob_from_handle(mob_handle handle) {
+    uint8_t idx = handle & 0xFF;
+    if (idx >= MAX_MOBS || !mob_check_flag(idx, IN_USE) ||
+        mobs_generation[idx] != (handle >> 8)) {
+        return MAX_MOBS;
+    }
+    return idx;
 }
 
 void destroy_mob(uint8_t idx) {
+    // Freeing a slot twice would put it on the free list twice
+    if (!mob_check_flag(idx, IN_USE)) {
+        return;
+    }
     mob_clr_flag(idx, IN_USE);
+    mobs_generation[idx]++;
+    for (uint8_t timer = 0; timer < MOB_TIMER_COUNT; timer++) {
+        mob_clr_timer(idx, timer);
+    }
     // Set the Y position to max value so this sprite sorts to the end of the
     // list
-    mobs_bot_y[idx] = 0xFF;
+    set_mob_bot_y(idx, 0xFF);
+    push_free_mob(idx);
 }
 
 void destroy_all_mobs(void) {
-    for (uint8_t i = 0; i < MAX_MOBS; i++) {
-        if (mob_check_flag(i, IN_USE)) {
-            destroy_mob(i);
-        }
+    for (uint8_t i = 0; i < mobs_active.count; i++) {
+        destroy_mob(mobs_active.idx[i]);
     }
+    compact_mob_lists();
+    // All of the queued jobs are now stale
+    memset(mob_jobs, 0, sizeof(mob_jobs));
 }
 
 static void animate_mob(uint8_t idx) {
     if (mobs_animation_count[idx] == 0) {
         mobs_sprite_frame[idx]++;
-        mobs_animation_count[idx] = mobs_animation_rate[idx];
+        mobs_animation_count[idx] = mob_get_archetype(idx)->animation_rate;
     } else {
         mobs_animation_count[idx]--;
     }
@@ -392,13 +782,68 @@ static void animate_mob(uint8_t idx) {
     }
 }
 
+void capture_mob_collisions(void) {
+    uint8_t bank = raster_get_build_bank();
+    bool valid = raster_collisions_valid();
+
+    for (uint8_t i = 0; i < MAX_MOBS; i++) {
+        uint8_t sprite_mask = mobs_draw_sprite_mask[bank][i];
+        if (!valid || !sprite_mask) {
+            mobs_sprite_collisions[i] = MOB_SPRITE_COLLISION_UNKNOWN;
+            continue;
+        }
+
+        uint8_t collisions = raster_get_sprite_collisions(
+            mobs_draw_first_cmd[bank][i], mobs_draw_last_cmd[bank][i],
+            sprite_mask);
+        if (collisions == RASTER_COLLISION_MISSED) {
+            mobs_sprite_collisions[i] = MOB_SPRITE_COLLISION_UNKNOWN;
+            continue;
+        }
+
+        uint8_t result = 0;
+        if (collisions & _BV(WEAPON_SPRITE_IDX)) {
+            result |= MOB_SPRITE_COLLISION_WEAPON;
+        }
+        if (collisions & _BV(PLAYER_SPRITE_IDX)) {
+            result |= MOB_SPRITE_COLLISION_PLAYER;
+        }
+        if (collisions & ~(sprite_mask | _BMASK(MOB_SPRITE_OFFSET))) {
+            result |= MOB_SPRITE_COLLISION_MOB;
+        }
+        mobs_sprite_collisions[i] = result;
+    }
+}
+
+bool mob_sprite_collided_weapon(uint8_t idx) {
+    return mobs_sprite_collisions[idx] & MOB_SPRITE_COLLISION_WEAPON;
+}
+
+bool mob_sprite_collided_player(uint8_t idx) {
+    return mobs_sprite_collisions[idx] & MOB_SPRITE_COLLISION_PLAYER;
+}
+
+// Marks every mob as not drawn in the bank being built. This must be called
+// whenever a bank is built without draw_mobs(), so that the collisions latched
+// for it are not matched against the commands of an older build
+void clear_mob_draws(void) {
+    uint8_t bank = raster_get_build_bank();
+
+    for (uint8_t i = 0; i < MAX_MOBS; i++) {
+        mobs_draw_sprite_mask[bank][i] = 0;
+    }
+}
+
 void draw_mobs(void) {
-    uint8_t sprite_enable = VICII_SPRITE_ENABLE & _BMASK(MOB_SPRITE_OFFSET);
-    uint8_t sprite_msb = VICII_SPRITE_MSB & _BMASK(MOB_SPRITE_OFFSET);
-    uint8_t sprite_y_expand = VICII_SPRITE_Y_EXPAND & _BMASK(MOB_SPRITE_OFFSET);
-    uint8_t sprite_x_expand = VICII_SPRITE_X_EXPAND & _BMASK(MOB_SPRITE_OFFSET);
-    uint8_t sprite_multicolor =
-        VICII_SPRITE_MULTICOLOR & _BMASK(MOB_SPRITE_OFFSET);
+    uint8_t bank = raster_get_build_bank();
+    struct sprite_registers* shadow = sprite_shadow;
+    uint8_t sprite_enable = shadow->enable & _BMASK(MOB_SPRITE_OFFSET);
+    uint8_t sprite_msb = shadow->msb & _BMASK(MOB_SPRITE_OFFSET);
+    uint8_t sprite_y_expand = shadow->y_expand & _BMASK(MOB_SPRITE_OFFSET);
+    uint8_t sprite_x_expand = shadow->x_expand & _BMASK(MOB_SPRITE_OFFSET);
+    uint8_t sprite_multicolor = shadow->multicolor & _BMASK(MOB_SPRITE_OFFSET);
+
+    clear_mob_draws();
 
     // Initial drawn sprites
     uint8_t sprite_idx = 7;
@@ -416,23 +861,27 @@ void draw_mobs(void) {
 
         sprite_enable |= sprite_mask;
 
+        mobs_draw_sprite_mask[bank][mob_idx] = sprite_mask;
+        mobs_draw_first_cmd[bank][mob_idx] = RASTER_CMD_NONE;
+        mobs_draw_last_cmd[bank][mob_idx] = RASTER_CMD_NONE;
+
         if (mob_get_x(mob_idx) & 0x0100) {
             sprite_msb |= sprite_mask;
         }
 
-        VICII_SPRITE_POSITION[sprite_idx].x = mob_get_x(mob_idx) & 0xFF;
-        VICII_SPRITE_POSITION[sprite_idx].y = mob_get_y(mob_idx);
+        shadow->x[sprite_idx] = mob_get_x(mob_idx) & 0xFF;
+        shadow->y[sprite_idx] = mob_get_y(mob_idx);
 
-        if (mobs_damage_counter[mob_idx] & 1) {
-            VICII_SPRITE_COLOR[sprite_idx] = mobs_damage_color[mob_idx];
+        const struct mob_archetype* archetype = mob_get_archetype(mob_idx);
+        if (mob_check_flag(mob_idx, DAMAGED) && (tick_count & 1)) {
+            shadow->color[sprite_idx] = archetype->damage_color;
         } else {
-            VICII_SPRITE_COLOR[sprite_idx] = mobs_color[mob_idx];
+            shadow->color[sprite_idx] = archetype->color;
         }
 
         uint8_t frame = mobs_sprite_frame[mob_idx];
 
-        sprite_pointers_shadow[sprite_idx] =
-            mobs_sprite[mob_idx]->pointers[frame];
+        shadow->pointer[sprite_idx] = mobs_sprite[mob_idx]->pointers[frame];
 
         uint8_t flags = mobs_sprite[mob_idx]->flags[frame];
 
@@ -449,27 +898,28 @@ void draw_mobs(void) {
         }
     }
 
-    VICII_SPRITE_ENABLE = sprite_enable;
-    VICII_SPRITE_MSB = sprite_msb;
-    VICII_SPRITE_Y_EXPAND = sprite_y_expand;
-    VICII_SPRITE_X_EXPAND = sprite_x_expand;
-    VICII_SPRITE_MULTICOLOR = sprite_multicolor;
+    shadow->enable = sprite_enable;
+    shadow->msb = sprite_msb;
+    shadow->y_expand = sprite_y_expand;
+    shadow->x_expand = sprite_x_expand;
+    shadow->multicolor = sprite_multicolor;
 
-    // Multiplexed sprites
+    // Multiplexed sprites. Each one reuses the hardware sprite of the mob
+    // NUM_MOB_SPRITES before it in the Y order, so the sprite index wraps
+    // around after the last mob sprite
     sprite_idx = 7;
     sprite_mask = _BV(7);
-#pragma clang loop unroll(full)
-    for (y_idx = NUM_MOB_SPRITES; y_idx < MAX_MOBS;
-         y_idx++, sprite_idx--, sprite_mask >>= 1) {
+    MULTIPLEX_LOOP_UNROLL
+    for (y_idx = NUM_MOB_SPRITES; y_idx < MAX_MOBS; y_idx++) {
         uint8_t mob_idx = mob_idx_by_y[y_idx];
         if (mobs_bot_y[mob_idx] == 0xFF) {
             // As soon as we see an invalid Y coordinate, we are done.
             break;
         }
 
-        uint8_t color = (mobs_damage_counter[mob_idx] & 1)
-                            ? mobs_damage_color[mob_idx]
-                            : mobs_color[mob_idx];
+        uint8_t color = (mob_check_flag(mob_idx, DAMAGED) && (tick_count & 1))
+                            ? mob_get_archetype(mob_idx)->damage_color
+                            : mob_get_archetype(mob_idx)->color;
 
         uint8_t frame = mobs_sprite_frame[mob_idx];
 
@@ -499,156 +949,287 @@ void draw_mobs(void) {
             sprite_multicolor &= ~sprite_mask;
         }
 
-        DISABLE_INTERRUPTS() {
-            uint8_t raster_idx = alloc_raster_cmd(
-                mobs_bot_y[mob_idx_by_y[y_idx - NUM_MOB_SPRITES]]);
-
-            raster_set_sprite(raster_idx, sprite_idx,
-                              mobs_sprite[mob_idx]->pointers[frame],
-                              mob_get_x(mob_idx) & 0xFF, mob_get_y(mob_idx),
-                              color, sprite_msb, sprite_x_expand,
-                              sprite_y_expand, sprite_multicolor);
+        uint8_t prev_mob_idx = mob_idx_by_y[y_idx - NUM_MOB_SPRITES];
+        uint8_t raster_idx = alloc_raster_cmd(mobs_bot_y[prev_mob_idx]);
+
+        // The previous mob on this hardware sprite is no longer drawn after
+        // this command
+        mobs_draw_last_cmd[bank][prev_mob_idx] = raster_idx;
+        mobs_draw_sprite_mask[bank][mob_idx] = sprite_mask;
+        mobs_draw_first_cmd[bank][mob_idx] = raster_idx + 1;
+        mobs_draw_last_cmd[bank][mob_idx] = RASTER_CMD_NONE;
+
+        raster_set_sprite(raster_idx, sprite_idx,
+                          mobs_sprite[mob_idx]->pointers[frame],
+                          mob_get_x(mob_idx) & 0xFF, mob_get_y(mob_idx), color,
+                          sprite_msb, sprite_x_expand, sprite_y_expand,
+                          sprite_multicolor);
+
+        if (sprite_idx == MOB_SPRITE_OFFSET) {
+            sprite_idx = 7;
+            sprite_mask = _BV(7);
+        } else {
+            sprite_idx--;
+            sprite_mask >>= 1;
         }
     }
 }
 
-static bool check_mob_move(uint8_t idx, int8_t move_x, int8_t move_y) {
-    if (move_x == 0 && move_y == 0) {
-        return true;
+static void check_mob_move(uint8_t idx, int8_t* move_x, int8_t* move_y) {
+    check_move(mobs_map_x[idx], mobs_map_y[idx], 0, move_x, move_y);
+
+    // Prevent mob bottom coordinate from going at or past 255
+    if (*move_y > 0 && mob_get_y(idx) + SPRITE_HEIGHT_PX >= 255 - *move_y) {
+        *move_y = 0;
+    }
+}
+
+void query_mobs_rows(uint8_t north, uint8_t south, struct mob_list* result) {
+    // The bounding box of a mob is inside its sprite, so it can only overlap
+    // the rows if the bottom of the sprite is below north and no more than a
+    // sprite height below south
+    uint16_t last_bot_y = south + SPRITE_HEIGHT_PX;
+    uint8_t count = 0;
+    uint8_t pos;
+
+    for (pos = 0; pos < mob_num_visible; pos++) {
+        uint8_t idx = mob_idx_by_y[pos];
+        uint8_t bot_y = mobs_bot_y[idx];
+        if (bot_y > last_bot_y) {
+            break;
+        }
+        if (bot_y > north) {
+            result->idx[count++] = idx;
+        }
     }
 
-    if (move_x > 0) {
-        if (mobs_map_x[idx] > MAP_WIDTH_PX - move_x) {
-            return false;
+    // Hidden mobs are at the end of the Y order, but can still collide
+    for (pos = mob_num_visible; pos < MAX_MOBS; pos++) {
+        uint8_t idx = mob_idx_by_y[pos];
+        if (mob_check_flag(idx, IN_USE)) {
+            result->idx[count++] = idx;
         }
-    } else if (move_x < 0) {
-        if (-move_x > mobs_map_x[idx]) {
-            return false;
+    }
+
+    result->count = count;
+}
+
+static void queue_reached_target_job(uint8_t idx) {
+    struct mob_job_queue* queue = &mob_jobs[mobs_lod[idx]];
+    uint8_t tail;
+
+    if (queue->count >= MOB_JOB_QUEUE_SIZE) {
+        return;
+    }
+
+    tail = queue->head + queue->count;
+    if (tail >= MOB_JOB_QUEUE_SIZE) {
+        tail -= MOB_JOB_QUEUE_SIZE;
+    }
+    queue->handle[tail] = mob_get_handle(idx);
+    queue->count++;
+    mobs_job_tick[idx] = tick_count;
+    mob_set_flag(idx, JOB_QUEUED);
+}
+
+static void pop_mob_job(struct mob_job_queue* queue) {
+    queue->head++;
+    if (queue->head >= MOB_JOB_QUEUE_SIZE) {
+        queue->head = 0;
+    }
+    queue->count--;
+}
+
+// Returns the mob of the first job in the queue, or MAX_MOBS if it is empty.
+// Stale jobs are dropped on the way
+static uint8_t peek_mob_job(struct mob_job_queue* queue) {
+    while (queue->count) {
+        uint8_t idx = mob_from_handle(queue->handle[queue->head]);
+        if (idx < MAX_MOBS) {
+            return idx;
         }
+        pop_mob_job(queue);
     }
+    return MAX_MOBS;
+}
 
-    if (move_y > 0) {
-        if (mobs_map_y[idx] > MAP_HEIGHT_PX - move_y) {
-            return false;
+static void run_reached_target_job(struct mob_job_queue* queue, uint8_t idx) {
+    pop_mob_job(queue);
+
+    mob_clr_flag(idx, JOB_QUEUED);
+    // The mob may have changed archetype since the job was queued
+    if (mob_check_flag(idx, REACHED_TARGET)) {
+        mob_clr_flag(idx, REACHED_TARGET);
+        if (mob_check_handler_flag(idx, REACHED_TARGET)) {
+            mob_get_archetype(idx)->on_reached_target(idx);
         }
+    }
+}
+
+#define mob_update_age(idx) ((uint8_t)(tick_count - mobs_last_update_tick[idx]))
 
-        // Prevent mob bottom coordinate from going at or past 255
-        if (mob_get_y(idx) + SPRITE_HEIGHT_PX >= 255 - move_y) {
-            return false;
+// Finds the next mob in round robin order with an update that is due, or
+// returns MAX_MOBS if there is none
+static uint8_t find_due_update(void) {
+    uint8_t idx = mob_update_idx;
+
+    for (uint8_t n = 0; n < MAX_MOBS; n++) {
+        if (mob_check_flag(idx, IN_USE) &&
+            mob_check_handler_flag(idx, UPDATE) &&
+            mob_update_age(idx) >= mobs_update_ticks[idx]) {
+            return idx;
         }
-    } else if (move_y < 0) {
-        if (-move_y > mobs_map_y[idx]) {
-            return false;
+
+        idx++;
+        if (idx >= MAX_MOBS) {
+            idx = 0;
         }
     }
+    return MAX_MOBS;
+}
+
+static void run_update_job(uint8_t idx) {
+    uint8_t age = mob_update_age(idx);
+
+    mob_update_idx = idx + 1;
+    if (mob_update_idx >= MAX_MOBS) {
+        mob_update_idx = 0;
+    }
 
-    uint8_t new_quad_x = (mobs_map_x[idx] + move_x) / QUAD_WIDTH_PX;
-    uint8_t new_quad_y = (mobs_map_y[idx] + move_y) / QUAD_HEIGHT_PX;
+    mobs_last_update_tick[idx] = tick_count;
+    mob_get_archetype(idx)->on_update(idx, age);
+}
 
-    return map_tile_is_passable(new_quad_x, new_quad_y);
+void run_mob_jobs(uint16_t budget_lines) {
+    struct mob_job_queue* near = &mob_jobs[MOB_LOD_NEAR];
+    struct mob_job_queue* far = &mob_jobs[MOB_LOD_FAR];
+    uint16_t start = get_raster();
+
+    // In order, run the first of: a far job that has waited too long, an update
+    // that has waited too long, a near job, a due update and then a far job
+    do {
+        uint8_t update_idx = find_due_update();
+        uint8_t near_idx = peek_mob_job(near);
+        uint8_t far_idx = peek_mob_job(far);
+
+        if (far_idx < MAX_MOBS &&
+            (uint8_t)(tick_count - mobs_job_tick[far_idx]) >=
+                MOB_JOB_MAX_WAIT) {
+            run_reached_target_job(far, far_idx);
+        } else if (update_idx < MAX_MOBS &&
+                   mob_update_age(update_idx) >=
+                       2 * mobs_update_ticks[update_idx]) {
+            run_update_job(update_idx);
+        } else if (near_idx < MAX_MOBS) {
+            run_reached_target_job(near, near_idx);
+        } else if (update_idx < MAX_MOBS) {
+            run_update_job(update_idx);
+        } else if (far_idx < MAX_MOBS) {
+            run_reached_target_job(far, far_idx);
+        } else {
+            break;
+        }
+    } while (get_raster_elapsed(start) < budget_lines);
 }
 
 void tick_mobs(void) {
-    bool called_reached_target = false;
+    uint8_t player_quad_x = player_get_quad_x();
+    uint8_t player_quad_y = player_get_quad_y();
 
-    for (uint8_t i = 0; i < MAX_MOBS; i++) {
+    tick_mob_timers();
+    compact_mob_lists();
+
+    // Mobs created while ticking are added to the end of the list and are
+    // ticked straight away
+    for (uint8_t n = 0; n < mobs_active.count; n++) {
+        uint8_t i = mobs_active.idx[n];
         if (!mob_check_flag(i, IN_USE)) {
             continue;
         }
 
-        if (mobs_damage_counter[i]) {
-            mobs_damage_counter[i]--;
-            if (mobs_damage_counter[i] == 0 && mobs_hp[i] <= 0) {
-                kill_mob(i);
-                continue;
-            }
-        }
-
-        if (mobs_damage_counter[i] &&
+        if (mob_check_flag(i, DAMAGED) &&
             (mobs_damage_push_x[i] || mobs_damage_push_y[i])) {
             int8_t move_x = mobs_damage_push_x[i];
             int8_t move_y = mobs_damage_push_y[i];
 
-            if (check_mob_move(i, move_x, move_y)) {
+            check_mob_move(i, &move_x, &move_y);
+            if (move_x || move_y) {
                 mob_inc_x(i, move_x);
                 mob_inc_y(i, move_y);
-            }
-        } else {
-            if (mob_check_flag(i, HAS_TARGET) && mobs_speed_pixels[i]) {
-                mobs_speed_counter[i]--;
-                if (mobs_speed_counter[i] == 0) {
-                    mobs_speed_counter[i] = mobs_speed_frames[i];
-                    if (mobs_map_x[i] < mobs_target_map_x[i]) {
-                        uint16_t delta = mobs_target_map_x[i] - mobs_map_x[i];
-                        if (delta < mobs_speed_pixels[i]) {
-                            mob_inc_x(i, delta);
-                        } else {
-                            mob_inc_x(i, mobs_speed_pixels[i]);
-                        }
-                    } else if (mobs_map_x[i] > mobs_target_map_x[i]) {
-                        uint16_t delta = mobs_map_x[i] - mobs_target_map_x[i];
-                        if (delta < mobs_speed_pixels[i]) {
-                            mob_inc_x(i, -delta);
-                        } else {
-                            mob_inc_x(i, -mobs_speed_pixels[i]);
-                        }
-                    }
-
-                    if (mobs_map_y[i] < mobs_target_map_y[i]) {
-                        uint8_t delta = mobs_target_map_y[i] - mobs_map_y[i];
-                        if (delta < mobs_speed_pixels[i]) {
-                            mob_inc_y(i, delta);
-                        } else {
-                            mob_inc_y(i, mobs_speed_pixels[i]);
-                        }
-                    } else if (mobs_map_y[i] > mobs_target_map_y[i]) {
-                        uint8_t delta = mobs_map_y[i] - mobs_target_map_y[i];
-                        if (delta < mobs_speed_pixels[i]) {
-                            mob_inc_y(i, -delta);
-                        } else {
-                            mob_inc_y(i, -mobs_speed_pixels[i]);
-                        }
-                    }
-
-                    if (mobs_map_x[i] == mobs_target_map_x[i] &&
-                        mobs_map_y[i] == mobs_target_map_y[i]) {
-                        mob_clr_flag(i, HAS_TARGET);
-                        mob_set_flag(i, REACHED_TARGET);
-                    }
+                if (mob_check_flag(i, HAS_TARGET)) {
+                    mob_calc_velocity(i);
                 }
             }
+        } else if (mob_check_flag(i, HAS_TARGET) && mobs_move_ticks[i]) {
+            // The fraction of the velocity is added to the sub-pixel
+            // position, and the carry out of it is added to the whole pixels
+            uint16_t subpixel_x =
+                mobs_subpixel_x[i] + (uint8_t)mobs_velocity_x[i];
+            uint16_t subpixel_y =
+                mobs_subpixel_y[i] + (uint8_t)mobs_velocity_y[i];
+            int8_t delta_x =
+                (int8_t)(mobs_velocity_x[i] >> 8) + (subpixel_x >> 8);
+            int8_t delta_y =
+                (int8_t)(mobs_velocity_y[i] >> 8) + (subpixel_y >> 8);
+
+            mobs_subpixel_x[i] = subpixel_x;
+            mobs_subpixel_y[i] = subpixel_y;
+            mob_inc_x(i, delta_x);
+            mob_inc_y(i, delta_y);
+
+            mobs_move_ticks[i]--;
+            if (mobs_move_ticks[i] == 0) {
+                mob_inc_x(i, mobs_target_map_x[i] - mobs_map_x[i]);
+                mob_inc_y(i, mobs_target_map_y[i] - mobs_map_y[i]);
+                mob_clr_flag(i, HAS_TARGET);
+                mob_set_flag(i, REACHED_TARGET);
+            }
         }
 
         set_bot_y(i);
+        update_mob_lod(i, player_quad_x, player_quad_y);
 
-        if (mob_check_flag(i, REACHED_TARGET) && !called_reached_target) {
+        if (mob_check_flag(i, REACHED_TARGET) &&
+            !mob_check_flag(i, JOB_QUEUED)) {
             if (mob_check_handler_flag(i, REACHED_TARGET)) {
-                mobs_on_reached_target[i](i);
-                called_reached_target = true;
+                queue_reached_target_job(i);
+            } else {
+                mob_clr_flag(i, REACHED_TARGET);
             }
-            mob_clr_flag(i, REACHED_TARGET);
         }
 
         animate_mob(i);
+    }
 
-        if (mob_check_handler_flag(i, MOB_COLLISION)) {
-            for (uint8_t collision_idx = 0; collision_idx < MAX_MOBS;
-                 collision_idx++) {
-                if (collision_idx == i) {
-                    continue;
-                }
-                if (check_mob_collision(collision_idx, mobs_bb16_north[i],
-                                        mobs_bb16_south[i], mobs_bb16_east[i],
-                                        mobs_bb16_west[i])) {
-                    mobs_on_mob_collision[i](i, collision_idx);
+    for (uint8_t n = 0; n < mobs_mob_collision.count; n++) {
+        uint8_t i = mobs_mob_collision.idx[n];
+        if (!mob_check_flag(i, IN_USE) ||
+            !mob_check_handler_flag(i, MOB_COLLISION) ||
+            !(mobs_sprite_collisions[i] & MOB_SPRITE_COLLISION_MOB)) {
+            continue;
+        }
+
+        mob_handle handle = mob_get_handle(i);
+        query_mobs_rows(mobs_bb16_north[i], mobs_bb16_south[i],
+                        &mobs_query);
+        for (uint8_t m = 0; m < mobs_query.count; m++) {
+            uint8_t collision_idx = mobs_query.idx[m];
+            if (collision_idx == i) {
+                continue;
+            }
+            if (check_mob_collision(collision_idx, mobs_bb16_north[i],
+                                    mobs_bb16_south[i], mobs_bb16_east[i],
+                                    mobs_bb16_west[i])) {
+                mob_get_archetype(i)->on_mob_collision(i, collision_idx);
+                // The handler may have destroyed the mob
+                if (mob_from_handle(handle) != i) {
+                    break;
                 }
             }
         }
     }
 
-    if (!called_reached_target) {
-        update_mobs();
-    }
+    run_mob_jobs(MOB_JOB_BUDGET_LINES);
 
     // If not all MOBs were drawn, set some mobs with lower Y values (those
     // guaranteed to be drawn) to invalid. This will prevent them from drawing,
@@ -665,34 +1246,20 @@ void tick_mobs(void) {
     // Note that a new sprite bottom will be recalculated on the next frame in
     // the loop above, overriding this
     //
-    // This isn't a 100% ideal solution, but it is a fast calculation
+    // This isn't a 100% ideal solution, but it is a fast calculation. Each
+    // hidden mob moves to the end of the Y order, so the next one to hide
+    // takes its place
     for (uint8_t i = 0; i < last_num_missed_sprites; i++) {
         if (i + last_num_missed_sprites >= MAX_MOBS) {
             break;
         }
-        mobs_bot_y[mob_idx_by_y[i + last_num_missed_sprites]] = 0xFF;
-    }
-
-    sort_mobs_y();
-}
-
-void update_mobs(void) {
-    if (mob_check_flag(mob_update_idx, IN_USE) &&
-        mob_check_handler_flag(mob_update_idx, UPDATE)) {
-        mobs_on_update[mob_update_idx](
-            mob_update_idx, tick_count - mobs_last_update_tick[mob_update_idx]);
-        mobs_last_update_tick[mob_update_idx] = tick_count;
-    }
-
-    mob_update_idx++;
-    if (mob_update_idx >= MAX_MOBS) {
-        mob_update_idx = 0;
+        set_mob_bot_y(mob_idx_by_y[last_num_missed_sprites], 0xFF);
     }
 }
 
 bool check_mob_collision(uint8_t idx, uint8_t north, uint8_t south,
                          uint16_t east, uint16_t west) {
-    if (mob_check_flag(idx, IN_USE) && mobs_damage_counter[idx] == 0) {
+    if (mob_check_flag(idx, IN_USE) && !mob_check_flag(idx, DAMAGED)) {
         return (mobs_bb16_north[idx] <= south &&
                 north <= mobs_bb16_south[idx] && mobs_bb16_west[idx] <= east &&
                 west <= mobs_bb16_east[idx]);
@@ -702,7 +1269,8 @@ bool check_mob_collision(uint8_t idx, uint8_t north, uint8_t south,
 
 void damage_mob(uint8_t idx, uint8_t damage) {
     mobs_hp[idx] -= damage;
-    mobs_damage_counter[idx] = 5;
+    mob_set_flag(idx, DAMAGED);
+    mob_set_timer(idx, MOB_TIMER_DAMAGE, DAMAGE_TICKS, mob_damage_end);
     mobs_damage_push_x[idx] = 0;
     mobs_damage_push_y[idx] = 0;
     if (mobs_hp[idx] <= 0) {
@@ -712,7 +1280,8 @@ void damage_mob(uint8_t idx, uint8_t damage) {
 
 void damage_mob_pushback(uint8_t idx, uint8_t damage, enum direction dir) {
     mobs_hp[idx] -= damage;
-    mobs_damage_counter[idx] = 5;
+    mob_set_flag(idx, DAMAGED);
+    mob_set_timer(idx, MOB_TIMER_DAMAGE, DAMAGE_TICKS, mob_damage_end);
     // Note if HP <= 0, mob will be killed after pushback
     switch (dir) {
         case NORTH:
@@ -744,7 +1313,7 @@ void damage_mob_pushback(uint8_t idx, uint8_t damage, enum direction dir) {
 
 void kill_mob(uint8_t idx) {
     if (mob_check_handler_flag(idx, DEATH)) {
-        mobs_on_death[idx](idx);
+        mob_get_archetype(idx)->on_death(idx);
     } else {
         destroy_mob(idx);
     }
@@ -8,19 +8,173 @@
 #include "sprite.h"
 #include "util.h"
 
+// The maximum number of mobs can be changed at build time. Any mobs past
+// NUM_MOB_SPRITES are drawn by reusing hardware sprites further down the
+// screen
+#ifndef MAX_MOBS
 #define MAX_MOBS (9)
+#endif
+
+// The number of raster lines each tick may spend running mob AI jobs (reached
+// target handlers and updates). At least one job is always run, so that the
+// jobs make progress even when the frame is already late
+#ifndef MOB_JOB_BUDGET_LINES
+#define MOB_JOB_BUDGET_LINES (16)
+#endif
+
+// Budget used on the NTSC frames where no tick is run
+#define MOB_JOB_CATCH_UP_LINES (4 * MOB_JOB_BUDGET_LINES)
+
+// Mob slots are split into classes, each with its own free list, so that
+// reserved slots (e.g. the arrow the player is drawing) are always available
+// no matter how many general mobs are alive. The reserved classes use the slots
+// at the end
+enum mob_class {
+    MOB_CLASS_GENERAL,
+    MOB_CLASS_PLAYER_PROJECTILE,
+    MOB_CLASS_COUNT,
+};
+
 #define RESERVED_MOBS (1)
-#define PLAYER_PROJECTILE_MOB_IDX (8)
+#define MOB_CLASS_PLAYER_PROJECTILE_FIRST (MAX_MOBS - RESERVED_MOBS)
+
+// A handle is a mob index with the generation of the slot in the high byte.
+// The generation changes each time the slot is freed, so a handle to a mob
+// that has been destroyed (even if the slot has been reused) is detected as
+// stale
+typedef uint16_t mob_handle;
+#define MOB_HANDLE_NONE (0xFFFF)
+
+// Hardware sprites 0 and 1 are used for the weapon and player
+#define MOB_SPRITE_OFFSET (2)
+#define NUM_MOB_SPRITES (8 - MOB_SPRITE_OFFSET)
+
+_Static_assert(MAX_MOBS >= NUM_MOB_SPRITES, "Too few mobs");
+// Mob indexes must stay below 0x80 so that 0xFF can be used as a marker, and
+// the raster commands for both banks fit in an 8-bit index
+_Static_assert(MAX_MOBS < 0x80, "Too many mobs");
 
 #define FRAMES(f) ARRAY_SIZE(f), f
 
+// Compact list of mob indexes. Mobs are added as soon as they qualify, but are
+// only removed from the list at the start of tick_mobs(), so anything iterating
+// a list must still check that the mob is in use
+struct mob_list {
+    uint8_t count;
+    uint8_t idx[MAX_MOBS];
+};
+
+extern struct mob_list mobs_active;
+extern struct mob_list mobs_mob_collision;
+
 typedef void (*mob_weapon_collision_handler)(uint8_t idx, uint8_t damage,
                                              enum direction dir);
 typedef void (*mob_action_handler)(uint8_t idx);
 typedef void (*mob_update_handler)(uint8_t idx, uint8_t num_frames);
 typedef void (*mob_mob_collision_handler)(uint8_t idx, uint8_t collision_idx);
 
+// Mob speeds are in 1/256ths of a pixel per tick
+#define MOB_SPEED(pixels, ticks) ((uint16_t)((pixels) * 256 / (ticks)))
+
+// Mobs with an update handler are due for an update this many ticks after the
+// last one, unless their level of detail says otherwise
+#define MOB_UPDATE_TICKS (8)
+
+// AI level of detail. Mobs far from the player update less often, have their
+// reached target jobs run after those of the near mobs, and can pick cheaper
+// behaviors with mob_get_lod()
+enum mob_lod {
+    MOB_LOD_NEAR,
+    MOB_LOD_FAR,
+    MOB_LOD_COUNT,
+};
+
+struct mob_lod_tiers {
+    // Mobs at least this many quads from the player in either X or Y are far
+    uint8_t far_quads;
+    uint8_t update_ticks[MOB_LOD_COUNT];
+};
+
+// Data that only one kind of mob needs is kept in a small payload for each
+// slot. A slot only holds one kind of mob at a time, so the kinds share the
+// same bytes. The kind of payload comes from the archetype
+enum mob_payload_kind {
+    MOB_PAYLOAD_NONE,
+    MOB_PAYLOAD_COIN,
+    MOB_PAYLOAD_ARROW,
+};
+
+union mob_payload {
+    struct {
+        bcd_u8 value;
+    } coin;
+    struct {
+        uint8_t direction;
+    } arrow;
+};
+
+// Each mob has one timer of each kind. The archetype timer belongs to the
+// archetype of the mob (e.g. its lifetime, or the cool down of an archer)
+enum mob_timer {
+    MOB_TIMER_ARCHETYPE,
+    MOB_TIMER_DAMAGE,
+    MOB_TIMER_COUNT,
+};
+
+enum mob_archetype_id {
+    MOB_ARCHETYPE_SKELETON,
+    MOB_ARCHETYPE_SKELETON_ARCHER,
+    MOB_ARCHETYPE_COIN,
+    MOB_ARCHETYPE_HEART,
+    // Arrow being drawn back by the player
+    MOB_ARCHETYPE_ARROW,
+    // Arrow loosed by the player
+    MOB_ARCHETYPE_PLAYER_ARROW,
+    // Arrow shot by a skeleton archer
+    MOB_ARCHETYPE_ENEMY_ARROW,
+    MOB_ARCHETYPE_BLOCKED_ARROW,
+    MOB_ARCHETYPE_COUNT,
+};
+
+// Everything that is shared by all mobs of the same kind. Each mob only stores
+// the ID of its archetype. Handlers that are NULL are never called
+struct mob_archetype {
+    struct sprite const* sprite;
+    struct bb const* bb;
+    int8_t hp;
+    uint8_t color;
+    uint8_t damage_color;
+    uint8_t animation_rate;
+    uint16_t speed;
+    bool hostile;
+    // Ticks until the mob starts blinking, then ticks until it is killed. The
+    // mob lives forever if lifetime_ticks is 0
+    uint8_t lifetime_ticks;
+    uint8_t blink_ticks;
+    // An enum mob_payload_kind
+    uint8_t payload;
+    // NULL if the mob is always near
+    struct mob_lod_tiers const* lod;
+    mob_weapon_collision_handler on_weapon_collision;
+    mob_action_handler on_player_collision;
+    mob_action_handler on_death;
+    mob_action_handler on_reached_target;
+    mob_update_handler on_update;
+    mob_mob_collision_handler on_mob_collision;
+};
+
+extern const struct mob_archetype skeleton_archetype;
+extern const struct mob_archetype skeleton_archer_archetype;
+extern const struct mob_archetype coin_archetype;
+extern const struct mob_archetype heart_archetype;
+extern const struct mob_archetype arrow_archetype;
+extern const struct mob_archetype player_arrow_archetype;
+extern const struct mob_archetype enemy_arrow_archetype;
+extern const struct mob_archetype blocked_arrow_archetype;
+
 void init_mobs(void);
+void mob_init_archetype(uint8_t idx, enum mob_archetype_id id);
+void mob_set_archetype(uint8_t idx, enum mob_archetype_id id);
 void mob_set_sprite(uint8_t idx, struct sprite const* sprite);
 uint8_t mob_has_sprite(uint8_t idx);
 void mob_set_bb(uint8_t idx, struct bb bb);
@@ -32,42 +186,48 @@ uint8_t mob_get_map_y(uint8_t idx);
 uint8_t mob_get_quad_x(uint8_t idx);
 uint8_t mob_get_quad_y(uint8_t idx);
 void mob_set_hp(uint8_t idx, int8_t hp);
-void mob_set_color(uint8_t idx, uint8_t color);
-void mob_set_damage_color(uint8_t idx, uint8_t color);
-void mob_set_speed(uint8_t idx, uint8_t speed_pixels, uint8_t speed_frames);
+void mob_set_speed(uint8_t idx, uint16_t speed);
+enum mob_lod mob_get_lod(uint8_t idx);
+// In debug builds, this stops the program if the archetype of the mob does
+// not use the kind of payload
+union mob_payload* mob_get_payload(uint8_t idx, enum mob_payload_kind kind);
+// The handler may be NULL if only mob_has_timer() is needed
+void mob_set_timer(uint8_t idx, enum mob_timer timer, uint8_t ticks,
+                   mob_action_handler handler);
+void mob_clr_timer(uint8_t idx, enum mob_timer timer);
+bool mob_has_timer(uint8_t idx, enum mob_timer timer);
 void mob_set_target(uint8_t idx, uint16_t map_x, uint8_t map_y);
 uint8_t mob_has_weapon_collision(uint8_t idx);
-void mob_set_weapon_collision_handler(uint8_t idx,
-                                      mob_weapon_collision_handler handler);
 void mob_trigger_weapon_collision(uint8_t idx, uint8_t damage,
                                   enum direction dir);
 uint8_t mob_is_hostile(uint8_t idx);
-void mob_set_hostile(uint8_t idx, bool hostile);
 uint8_t mob_has_player_collision(uint8_t idx);
-void mob_set_player_collision_handler(uint8_t idx, mob_action_handler handler);
 void mob_trigger_player_collision(uint8_t idx);
-void mob_set_death_handler(uint8_t idx, mob_action_handler handler);
-void mob_set_reached_target_handler(uint8_t idx, mob_action_handler handler);
-void mob_set_update_handler(uint8_t idx, mob_update_handler handler);
-void mob_set_animation_rate(uint8_t idx, uint8_t frames);
-void mob_set_mob_collision_handler(uint8_t idx,
-                                   mob_mob_collision_handler handler);
 
 uint8_t mob_in_use(uint8_t idx);
 uint8_t alloc_mob(void);
-bool alloc_mob_idx(uint8_t idx);
+uint8_t alloc_mob_class(enum mob_class mob_class);
+mob_handle mob_get_handle(uint8_t idx);
+uint8_t mob_from_handle(mob_handle handle);
 void destroy_mob(uint8_t idx);
 void destroy_all_mobs(void);
+void clear_mob_draws(void);
 void draw_mobs(void);
 void tick_mobs(void);
-void update_mobs(void);
+void run_mob_jobs(uint16_t budget_lines);
 void capture_mob_collisions(void);
+bool mob_sprite_collided_weapon(uint8_t idx);
+bool mob_sprite_collided_player(uint8_t idx);
 void damage_mob(uint8_t idx, uint8_t damage);
 void damage_mob_pushback(uint8_t idx, uint8_t damage, enum direction dir);
 void kill_mob(uint8_t idx);
 
 bool check_mob_collision(uint8_t idx, uint8_t north, uint8_t south,
                          uint16_t east, uint16_t west);
+// Finds the mobs that might overlap the rows from north to south (in sprite
+// coordinates) by walking the Y order. The results still need to be checked
+// with check_mob_collision()
+void query_mobs_rows(uint8_t north, uint8_t south, struct mob_list* result);
 
 uint8_t create_skeleton(uint16_t map_x, uint8_t map_y);
 uint8_t create_skeleton_archer(uint16_t map_x, uint8_t map_y);
@@ -78,4 +238,13 @@ void create_arrow(uint8_t idx, uint16_t map_x, uint8_t map_y,
 enum direction arrow_get_direction(uint8_t idx);
 uint8_t create_blocked_arrow(uint16_t map_x, uint8_t map_y);
 
+// Game logic used by the archetypes, implemented in main.c
+void on_skeleton_kill(uint8_t idx);
+void on_powerup_kill(uint8_t idx);
+void skeleton_reached_target(uint8_t idx);
+void skeleton_archer_reached_target(uint8_t idx);
+void skeleton_player_collision(uint8_t idx);
+void skeleton_archer_update(uint8_t idx, uint8_t num_frames);
+void arrow_player_collision(uint8_t idx);
+
 #endif
@@ -22,12 +22,50 @@ static const struct sprite blocked_arrow = {
 
 static void on_reached_target(uint8_t idx) { kill_mob(idx); }
 
-static uint8_t arrow_direction[MAX_MOBS];
+// The sprite and bounding box are replaced by create_arrow() depending on the
+// direction
+const struct mob_archetype arrow_archetype = {
+    .sprite = &arrow_north,
+    .bb = &arrow_north_bb,
+    .hp = 1,
+    .color = COLOR_ORANGE,
+    .speed = MOB_SPEED(3, 1),
+    .payload = MOB_PAYLOAD_ARROW,
+    .on_reached_target = on_reached_target,
+};
+
+const struct mob_archetype player_arrow_archetype = {
+    .sprite = &arrow_north,
+    .bb = &arrow_north_bb,
+    .hp = 1,
+    .color = COLOR_ORANGE,
+    .speed = MOB_SPEED(3, 1),
+    .payload = MOB_PAYLOAD_ARROW,
+    .on_reached_target = on_reached_target,
+    .on_mob_collision = arrow_on_mob_collision,
+};
 
-enum direction arrow_get_direction(uint8_t idx) { return arrow_direction[idx]; }
+const struct mob_archetype enemy_arrow_archetype = {
+    .sprite = &arrow_north,
+    .bb = &arrow_north_bb,
+    .hp = 1,
+    .color = COLOR_ORANGE,
+    .speed = MOB_SPEED(3, 1),
+    .payload = MOB_PAYLOAD_ARROW,
+    .on_player_collision = arrow_player_collision,
+    .on_reached_target = on_reached_target,
+};
+
+#define arrow_data(idx) (mob_get_payload(idx, MOB_PAYLOAD_ARROW)->arrow)
+
+enum direction arrow_get_direction(uint8_t idx) {
+    return arrow_data(idx).direction;
+}
 
 void create_arrow(uint8_t idx, uint16_t map_x, uint8_t map_y,
                   enum direction direction) {
+    mob_init_archetype(idx, MOB_ARCHETYPE_ARROW);
+
     switch (direction) {
         case NORTH:
             mob_set_sprite(idx, &arrow_north);
@@ -51,23 +89,24 @@ void create_arrow(uint8_t idx, uint16_t map_x, uint8_t map_y,
     };
 
     mob_set_position(idx, map_x, map_y);
-    mob_set_hp(idx, 1);
-    mob_set_color(idx, COLOR_ORANGE);
-    mob_set_reached_target_handler(idx, on_reached_target);
-
-    mob_set_speed(idx, 3, 1);
-    arrow_direction[idx] = direction;
+    arrow_data(idx).direction = direction;
 }
 
-static uint8_t blocked_arrow_ttl[MAX_MOBS];
+static const struct bb blocked_arrow_bb = {
+    .north = 0,
+    .south = SPRITE_HEIGHT_PX - 1,
+    .east = SPRITE_WIDTH_PX - 1,
+    .west = 0,
+};
 
-static void on_blocked_arrow_update(uint8_t idx, uint8_t num_frames) {
-    if (num_frames >= blocked_arrow_ttl[idx]) {
-        kill_mob(idx);
-    } else {
-        blocked_arrow_ttl[idx] -= num_frames;
-    }
-}
+const struct mob_archetype blocked_arrow_archetype = {
+    .sprite = &blocked_arrow,
+    .bb = &blocked_arrow_bb,
+    .hp = 1,
+    .color = COLOR_ORANGE,
+    .animation_rate = 2,
+    .lifetime_ticks = 20,
+};
 
 uint8_t create_blocked_arrow(uint16_t map_x, uint8_t map_y) {
     uint8_t idx = alloc_mob();
@@ -88,13 +127,8 @@ uint8_t create_blocked_arrow(uint16_t map_x, uint8_t map_y) {
         blocked_arrow_needs_created = false;
     }
 
+    mob_init_archetype(idx, MOB_ARCHETYPE_BLOCKED_ARROW);
     mob_set_position(idx, map_x, map_y);
-    mob_set_hp(idx, 1);
-    mob_set_color(idx, COLOR_ORANGE);
-    mob_set_sprite(idx, &blocked_arrow);
-    mob_set_animation_rate(idx, 2);
-    mob_set_update_handler(idx, on_blocked_arrow_update);
-    blocked_arrow_ttl[idx] = 20;
 
     return idx;
 }
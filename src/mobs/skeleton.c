@@ -5,23 +5,36 @@
 
 static const struct sprite skeleton = SKELETON_SPRITE;
 
+// Far skeletons plan longer moves, see skeleton_reached_target()
+static const struct mob_lod_tiers skeleton_lod = {
+    .far_quads = 6,
+    .update_ticks = {MOB_UPDATE_TICKS, MOB_UPDATE_TICKS},
+};
+
+const struct mob_archetype skeleton_archetype = {
+    .sprite = &skeleton,
+    .bb = &skeleton_bb,
+    .hp = 10,
+    .color = COLOR_WHITE,
+    .damage_color = COLOR_ORANGE,
+    .animation_rate = 60,
+    .speed = MOB_SPEED(1, 5),
+    .hostile = true,
+    .lod = &skeleton_lod,
+    .on_weapon_collision = damage_mob_pushback,
+    .on_player_collision = skeleton_player_collision,
+    .on_death = on_skeleton_kill,
+    .on_reached_target = skeleton_reached_target,
+};
+
 uint8_t create_skeleton(uint16_t map_x, uint8_t map_y) {
     uint8_t idx = alloc_mob();
     if (idx == MAX_MOBS) {
         return MAX_MOBS;
     }
 
-    mob_set_sprite(idx, &skeleton);
-    mob_set_bb(idx, skeleton_bb);
+    mob_init_archetype(idx, MOB_ARCHETYPE_SKELETON);
     mob_set_position(idx, map_x, map_y);
-    mob_set_hp(idx, 10);
-    mob_set_color(idx, COLOR_WHITE);
-    mob_set_damage_color(idx, COLOR_ORANGE);
-    mob_set_animation_rate(idx, 60);
-    mob_set_hostile(idx, true);
-
-    mob_set_weapon_collision_handler(idx, damage_mob_pushback);
-    mob_set_speed(idx, 1, 5);
 
     return idx;
 }
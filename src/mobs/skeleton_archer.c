@@ -5,25 +5,37 @@
 
 static const struct sprite skeleton_archer = SKELETON_ARCHER_SPRITE;
 
+// Far archers look for the player less often
+static const struct mob_lod_tiers skeleton_archer_lod = {
+    .far_quads = 8,
+    .update_ticks = {MOB_UPDATE_TICKS, 3 * MOB_UPDATE_TICKS},
+};
+
+const struct mob_archetype skeleton_archer_archetype = {
+    .sprite = &skeleton_archer,
+    .bb = &skeleton_archer_bb,
+    .hp = 3,
+    .color = COLOR_WHITE,
+    .damage_color = COLOR_ORANGE,
+    .animation_rate = 60,
+    .speed = MOB_SPEED(1, 5),
+    .hostile = true,
+    .lod = &skeleton_archer_lod,
+    .on_weapon_collision = damage_mob_pushback,
+    .on_player_collision = skeleton_player_collision,
+    .on_death = on_skeleton_kill,
+    .on_reached_target = skeleton_archer_reached_target,
+    .on_update = skeleton_archer_update,
+};
+
 uint8_t create_skeleton_archer(uint16_t map_x, uint8_t map_y) {
     uint8_t idx = alloc_mob();
     if (idx == MAX_MOBS) {
         return MAX_MOBS;
     }
 
-    mob_set_sprite(idx, &skeleton_archer);
-    mob_set_bb(idx, skeleton_archer_bb);
+    mob_init_archetype(idx, MOB_ARCHETYPE_SKELETON_ARCHER);
     mob_set_position(idx, map_x, map_y);
-    mob_set_hp(idx, 3);
-    mob_set_color(idx, COLOR_WHITE);
-    mob_set_damage_color(idx, COLOR_ORANGE);
-    mob_set_animation_rate(idx, 60);
-    mob_set_hostile(idx, true);
-
-    mob_set_weapon_collision_handler(idx, damage_mob_pushback);
-    mob_set_speed(idx, 1, 5);
 
     return idx;
 }
-
-
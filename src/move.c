@@ -7,53 +7,55 @@
 #include "map.h"
 #include "sprite.h"
 
-#define BB_PAD_NORTH (4)
-#define BB_PAD_SOUTH (4)
-#define BB_PAD_EAST (4)
-#define BB_PAD_WEST (4)
+// Returns how far the point can move in the direction before it is less than
+// pad pixels from an impassable quad or the edge of the map. offset is the
+// distance from the point to the edge of its quad in that direction
+static uint8_t move_room(uint8_t quad_x, uint8_t quad_y, enum direction dir,
+                         uint8_t offset, uint8_t pad) {
+    uint8_t room = offset + map_tile_get_clearance(quad_x, quad_y, dir);
+    if (room < pad) {
+        return 0;
+    }
+    return room - pad;
+}
+
+// Clamps the move so that the point stays at least pad pixels away from
+// impassable quads and the edges of the map. The X move is clamped first, and
+// the Y move is then clamped from the column where the X move ends, so that a
+// diagonal move can not clip through the corner between two blocked quads
+void check_move(uint16_t map_x, uint8_t map_y, uint8_t pad, int8_t* move_x,
+                int8_t* move_y) {
+    uint8_t quad_x = map_x / QUAD_WIDTH_PX;
+    uint8_t quad_y = map_y / QUAD_HEIGHT_PX;
+    uint8_t offset_x = map_x & (QUAD_WIDTH_PX - 1);
+    uint8_t offset_y = map_y & (QUAD_HEIGHT_PX - 1);
+    uint8_t room;
 
-void check_move(uint16_t map_x, uint8_t map_y, int8_t* move_x, int8_t* move_y) {
-    int8_t check_x = 0;
-    int8_t check_y = 0;
     if (*move_x < 0) {
-        check_x = *move_x - BB_PAD_WEST;
-        if (-check_x > map_x) {
-            check_x = 0;
-            *move_x = 0;
+        room = move_room(quad_x, quad_y, WEST, offset_x, pad);
+        if (-*move_x > room) {
+            *move_x = -room;
         }
     } else if (*move_x > 0) {
-        check_x = *move_x + BB_PAD_EAST;
-        if (map_x > MAP_WIDTH_PX - check_x) {
-            check_x = 0;
-            *move_x = 0;
+        room = move_room(quad_x, quad_y, EAST,
+                         QUAD_WIDTH_PX - 1 - offset_x, pad);
+        if (*move_x > room) {
+            *move_x = room;
         }
     }
 
+    quad_x = (map_x + *move_x) / QUAD_WIDTH_PX;
+
     if (*move_y < 0) {
-        check_y = *move_y - BB_PAD_NORTH;
-        if (-check_y > map_y) {
-            check_y = 0;
-            *move_y = 0;
+        room = move_room(quad_x, quad_y, NORTH, offset_y, pad);
+        if (-*move_y > room) {
+            *move_y = -room;
         }
     } else if (*move_y > 0) {
-        check_y = *move_y + BB_PAD_EAST;
-        if (map_y > MAP_HEIGHT_PX - check_y) {
-            check_y = 0;
-            *move_y = 0;
+        room = move_room(quad_x, quad_y, SOUTH,
+                         QUAD_HEIGHT_PX - 1 - offset_y, pad);
+        if (*move_y > room) {
+            *move_y = room;
         }
     }
-
-    if (!*move_x && !*move_y) {
-        return;
-    }
-
-    if (!map_tile_is_passable((map_x + check_x) / QUAD_HEIGHT_PX,
-                              map_y / QUAD_HEIGHT_PX)) {
-        *move_x = 0;
-    }
-
-    if (!map_tile_is_passable(map_x / QUAD_WIDTH_PX,
-                              (map_y + check_y) / QUAD_HEIGHT_PX)) {
-        *move_y = 0;
-    }
 }
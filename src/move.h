@@ -7,6 +7,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-void check_move(uint16_t map_x, uint8_t map_y, int8_t *move_x, int8_t *move_y);
+void check_move(uint16_t map_x, uint8_t map_y, uint8_t pad, int8_t *move_x,
+                int8_t *move_y);
 
 #endif
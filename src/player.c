@@ -17,6 +17,8 @@
 #include "trigconst.h"
 
 #define PLAYER_SPEED (2)
+// How close the center of the player can get to an impassable quad
+#define PLAYER_MOVE_PAD (4)
 
 #define PLAYER_ANIMATION_RATE (10)
 #define WEAPON_ANIMATION_RATE (10)
@@ -41,6 +43,8 @@ static uint8_t player_sword_damage;
 static uint8_t player_flail_damage;
 static uint8_t player_arrow_damage;
 static bool bow_drawing;
+static mob_handle bow_arrow = MOB_HANDLE_NONE;
+static struct mob_list player_query;
 
 static bcd_u16 player_coins;
 bool player_coins_changed;
@@ -108,6 +112,7 @@ void init_player(void) {
     player_sword_damage = 1;
     player_flail_damage = 1;
     bow_drawing = false;
+    bow_arrow = MOB_HANDLE_NONE;
 }
 
 bool damage_player(uint8_t damage) {
@@ -213,11 +218,12 @@ uint16_t player_weapon_get_x(void) { return weapon_x; }
 uint8_t player_weapon_get_y(void) { return weapon_y; }
 
 void draw_player(void) {
-    uint8_t sprite_enable = VICII_SPRITE_ENABLE & 0xFC;
-    uint8_t sprite_msb = VICII_SPRITE_MSB & 0xFC;
-    uint8_t sprite_y_expand = VICII_SPRITE_Y_EXPAND & 0xFC;
-    uint8_t sprite_x_expand = VICII_SPRITE_X_EXPAND & 0xFC;
-    uint8_t sprite_multicolor = VICII_SPRITE_MULTICOLOR & 0xFC;
+    struct sprite_registers* shadow = sprite_shadow;
+    uint8_t sprite_enable = shadow->enable & 0xFC;
+    uint8_t sprite_msb = shadow->msb & 0xFC;
+    uint8_t sprite_y_expand = shadow->y_expand & 0xFC;
+    uint8_t sprite_x_expand = shadow->x_expand & 0xFC;
+    uint8_t sprite_multicolor = shadow->multicolor & 0xFC;
 
     if (weapon_state == WEAPON_VISIBLE) {
         sprite_enable |= _BV(WEAPON_SPRITE_IDX);
@@ -253,9 +259,9 @@ void draw_player(void) {
                 break;
         }
 
-        sprite_pointers_shadow[WEAPON_SPRITE_IDX] = sprite_pointer;
+        shadow->pointer[WEAPON_SPRITE_IDX] = sprite_pointer;
 
-        VICII_SPRITE_COLOR[WEAPON_SPRITE_IDX] = color;
+        shadow->color[WEAPON_SPRITE_IDX] = color;
 
         if (flags & SPRITE_IMAGE_EXPAND_X) {
             sprite_x_expand |= _BV(WEAPON_SPRITE_IDX);
@@ -269,8 +275,8 @@ void draw_player(void) {
             sprite_multicolor |= _BV(WEAPON_SPRITE_IDX);
         }
 
-        VICII_SPRITE_POSITION[WEAPON_SPRITE_IDX].x = weapon_x & 0xFF;
-        VICII_SPRITE_POSITION[WEAPON_SPRITE_IDX].y = weapon_y;
+        shadow->x[WEAPON_SPRITE_IDX] = weapon_x & 0xFF;
+        shadow->y[WEAPON_SPRITE_IDX] = weapon_y;
         if (weapon_x & 0x100) {
             sprite_msb |= _BV(WEAPON_SPRITE_IDX);
         }
@@ -298,41 +304,41 @@ void draw_player(void) {
 
         uint16_t x = player_get_x();
 
-        VICII_SPRITE_POSITION[PLAYER_SPRITE_IDX].x = x & 0xFF;
-        VICII_SPRITE_POSITION[PLAYER_SPRITE_IDX].y = player_get_y();
+        shadow->x[PLAYER_SPRITE_IDX] = x & 0xFF;
+        shadow->y[PLAYER_SPRITE_IDX] = player_get_y();
         if (x & 0x100) {
             sprite_msb |= _BV(PLAYER_SPRITE_IDX);
         }
 
         switch (player_temp_invulnerable & 0x3) {
             case 0:
-                VICII_SPRITE_COLOR[PLAYER_SPRITE_IDX] = PLAYER_COLOR;
+                shadow->color[PLAYER_SPRITE_IDX] = PLAYER_COLOR;
                 break;
 
             case 1:
-                VICII_SPRITE_COLOR[PLAYER_SPRITE_IDX] = PLAYER_HIT_COLOR_1;
+                shadow->color[PLAYER_SPRITE_IDX] = PLAYER_HIT_COLOR_1;
                 break;
 
             case 2:
-                VICII_SPRITE_COLOR[PLAYER_SPRITE_IDX] = PLAYER_HIT_COLOR_2;
+                shadow->color[PLAYER_SPRITE_IDX] = PLAYER_HIT_COLOR_2;
                 break;
 
             case 3:
-                VICII_SPRITE_COLOR[PLAYER_SPRITE_IDX] = PLAYER_HIT_COLOR_3;
+                shadow->color[PLAYER_SPRITE_IDX] = PLAYER_HIT_COLOR_3;
                 break;
         }
-        sprite_pointers_shadow[PLAYER_SPRITE_IDX] =
+        shadow->pointer[PLAYER_SPRITE_IDX] =
             sprite->pointers[player_dir][player_frame];
     }
 
-    VICII_SPRITE_ENABLE = sprite_enable;
-    VICII_SPRITE_MSB = sprite_msb;
-    VICII_SPRITE_Y_EXPAND = sprite_y_expand;
-    VICII_SPRITE_X_EXPAND = sprite_x_expand;
-    VICII_SPRITE_MULTICOLOR = sprite_multicolor;
+    shadow->enable = sprite_enable;
+    shadow->msb = sprite_msb;
+    shadow->y_expand = sprite_y_expand;
+    shadow->x_expand = sprite_x_expand;
+    shadow->multicolor = sprite_multicolor;
 }
 
-static void arrow_on_mob_collision(uint8_t idx, uint8_t collision_idx) {
+void arrow_on_mob_collision(uint8_t idx, uint8_t collision_idx) {
     if (mob_is_hostile(collision_idx)) {
         mob_trigger_weapon_collision(collision_idx, player_arrow_damage,
                                      arrow_get_direction(idx));
@@ -352,56 +358,67 @@ void tick_player(void) {
         player_push_y = 0;
     }
 
-    if (weapon_state == WEAPON_VISIBLE) {
-        struct bb16 const sword_bb16 =
-            bb_add_offset(get_weapon_bb(), weapon_x, weapon_y);
+    struct bb16 const player_bb16 =
+        bb_add_offset(get_player_bb(), player_get_x(), player_get_y());
+    struct bb16 sword_bb16;
+    uint8_t query_north = player_bb16.north;
+    uint8_t query_south = player_bb16.south;
+    bool weapon_visible = weapon_state == WEAPON_VISIBLE;
+
+    if (weapon_visible) {
+        sword_bb16 = bb_add_offset(get_weapon_bb(), weapon_x, weapon_y);
+        if (sword_bb16.north < query_north) {
+            query_north = sword_bb16.north;
+        }
+        if (sword_bb16.south > query_south) {
+            query_south = sword_bb16.south;
+        }
+    } else {
+        weapon_move_counter = 0;
+    }
 
-#pragma clang loop unroll(full)
-        for (uint8_t idx = 0; idx < MAX_MOBS; idx++) {
-            if (mob_has_weapon_collision(idx) &&
-                check_mob_collision(idx, sword_bb16.north, sword_bb16.south,
-                                    sword_bb16.east, sword_bb16.west)) {
-                bool hostile = mob_is_hostile(idx);
+    // The weapon and player collisions are found with a single query that
+    // covers the rows of both
+    query_mobs_rows(query_north, query_south, &player_query);
+
+    for (uint8_t n = 0; n < player_query.count; n++) {
+        uint8_t idx = player_query.idx[n];
+        if (weapon_visible && mob_has_weapon_collision(idx) &&
+            mob_sprite_collided_weapon(idx) &&
+            check_mob_collision(idx, sword_bb16.north, sword_bb16.south,
+                                sword_bb16.east, sword_bb16.west)) {
+            bool hostile = mob_is_hostile(idx);
+
+            switch (current_weapon) {
+                case WEAPON_SWORD:
+                    mob_trigger_weapon_collision(idx, player_sword_damage,
+                                                 player_dir);
+                    if (hostile) {
+                        weapon_state = WEAPON_ATTACKED;
+                    }
+                    break;
 
-                switch (current_weapon) {
-                    case WEAPON_SWORD:
-                        mob_trigger_weapon_collision(idx, player_sword_damage,
-                                                     player_dir);
-                        if (hostile) {
-                            weapon_state = WEAPON_ATTACKED;
-                        }
-                        break;
+                case WEAPON_FLAIL:
+                    mob_trigger_weapon_collision(
+                        idx, player_flail_damage + flail_speed - 1,
+                        dir_from(player_map_x, player_map_y,
+                                 mob_get_map_x(idx), mob_get_map_y(idx)));
 
-                    case WEAPON_FLAIL:
-                        mob_trigger_weapon_collision(
-                            idx, player_flail_damage + flail_speed - 1,
-                            dir_from(player_map_x, player_map_y,
-                                     mob_get_map_x(idx), mob_get_map_y(idx)));
-
-                        if (hostile) {
-                            flail_speed--;
-                            flail_timer = 0;
-                            if (!flail_speed) {
-                                weapon_state = WEAPON_ATTACKED;
-                            }
+                    if (hostile) {
+                        flail_speed--;
+                        flail_timer = 0;
+                        if (!flail_speed) {
+                            weapon_state = WEAPON_ATTACKED;
                         }
-                        break;
+                    }
+                    break;
 
-                    case WEAPON_BOW:
-                        break;
-                }
+                case WEAPON_BOW:
+                    break;
             }
         }
-    } else {
-        weapon_move_counter = 0;
-    }
 
-    struct bb16 const player_bb16 =
-        bb_add_offset(get_player_bb(), player_get_x(), player_get_y());
-
-#pragma clang loop unroll(full)
-    for (uint8_t idx = 0; idx < MAX_MOBS; idx++) {
-        if (mob_has_player_collision(idx) &&
+        if (mob_has_player_collision(idx) && mob_sprite_collided_player(idx) &&
             check_mob_collision(idx, player_bb16.north, player_bb16.south,
                                 player_bb16.east, player_bb16.west)) {
             mob_trigger_player_collision(idx);
@@ -421,15 +438,18 @@ void tick_player(void) {
                         weapon_state = WEAPON_VISIBLE;
                         break;
 
-                    case WEAPON_BOW:
-                        if (alloc_mob_idx(PLAYER_PROJECTILE_MOB_IDX)) {
-                            create_arrow(PLAYER_PROJECTILE_MOB_IDX,
-                                         player_map_x, player_map_y,
+                    case WEAPON_BOW: {
+                        uint8_t idx =
+                            alloc_mob_class(MOB_CLASS_PLAYER_PROJECTILE);
+                        if (idx != MAX_MOBS) {
+                            create_arrow(idx, player_map_x, player_map_y,
                                          player_dir);
+                            bow_arrow = mob_get_handle(idx);
                             bow_drawing = true;
                             weapon_state = WEAPON_VISIBLE;
                         }
                         break;
+                    }
                 }
             }
             if (m & _BV(JOYSTICK_UP_BIT)) {
@@ -452,38 +472,41 @@ void tick_player(void) {
                     case WEAPON_FLAIL:
                         break;
 
-                    case WEAPON_BOW:
+                    case WEAPON_BOW: {
+                        // The arrow may have been destroyed while it was
+                        // being drawn
+                        uint8_t idx = mob_from_handle(bow_arrow);
+                        bow_arrow = MOB_HANDLE_NONE;
+                        if (idx == MAX_MOBS) {
+                            break;
+                        }
                         if (weapon_move_counter >= BOW_DRAW_TIME) {
-                            mob_set_mob_collision_handler(
-                                PLAYER_PROJECTILE_MOB_IDX,
-                                arrow_on_mob_collision);
+                            mob_set_archetype(idx,
+                                              MOB_ARCHETYPE_PLAYER_ARROW);
                             switch (player_dir) {
                                 case NORTH:
-                                    mob_set_target(PLAYER_PROJECTILE_MOB_IDX,
-                                                   player_map_x, 0);
+                                    mob_set_target(idx, player_map_x, 0);
                                     break;
 
                                 case SOUTH:
-                                    mob_set_target(PLAYER_PROJECTILE_MOB_IDX,
-                                                   player_map_x,
+                                    mob_set_target(idx, player_map_x,
                                                    MAP_HEIGHT_PX - 1);
                                     break;
 
                                 case EAST:
-                                    mob_set_target(PLAYER_PROJECTILE_MOB_IDX,
-                                                   MAP_WIDTH_PX - 1,
+                                    mob_set_target(idx, MAP_WIDTH_PX - 1,
                                                    player_map_y);
                                     break;
 
                                 case WEST:
-                                    mob_set_target(PLAYER_PROJECTILE_MOB_IDX, 0,
-                                                   player_map_y);
+                                    mob_set_target(idx, 0, player_map_y);
                                     break;
                             }
                         } else {
-                            kill_mob(PLAYER_PROJECTILE_MOB_IDX);
+                            kill_mob(idx);
                         }
                         break;
+                    }
                 }
             }
             weapon_state = WEAPON_AWAY;
@@ -523,7 +546,8 @@ void tick_player(void) {
             }
         }
     }
-    check_move(player_map_x, player_map_y, &move_delta_x, &move_delta_y);
+    check_move(player_map_x, player_map_y, PLAYER_MOVE_PAD, &move_delta_x,
+               &move_delta_y);
 
     if (move_delta_x || move_delta_y) {
         if (player_animation_counter == 0) {
@@ -692,7 +716,10 @@ void tick_player(void) {
                     x = player_map_x;
                     y = player_map_y;
                 }
-                mob_set_position(PLAYER_PROJECTILE_MOB_IDX, x, y);
+                uint8_t idx = mob_from_handle(bow_arrow);
+                if (idx != MAX_MOBS) {
+                    mob_set_position(idx, x, y);
+                }
                 weapon_x = player_get_x() + bow_offset_x[player_dir];
                 weapon_y = player_get_y() + bow_offset_y[player_dir];
                 break;
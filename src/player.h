@@ -68,4 +68,6 @@ void tick_player(void);
 struct bb const* get_player_bb(void);
 struct bb const* get_weapon_bb(void);
 
+void arrow_on_mob_collision(uint8_t idx, uint8_t collision_idx);
+
 #endif
@@ -11,6 +11,7 @@
 
 typedef void (*isr_proc)(void);
 #define ISR_ADDR (*((isr_proc volatile *)0xFFFE))
+#define NMI_ADDR (*((isr_proc volatile *)0xFFFA))
 #define ISR_VECTOR (*((isr_proc volatile *)0x0314))
 
 #define PROCESSOR_DDR REG(0x0000)
@@ -153,7 +154,10 @@ typedef void (*isr_proc)(void);
 #define CIA_2_TIMER_A_CTRL CIA_2_REG(TIMER_A_CTRL)
 #define CIA_2_TIMER_B_CTRL CIA_2_REG(TIMER_B_CTRL)
 
+// Base of the VIC bank
 extern uint8_t video_base;
+// Start of the graphics loaded from disk
+extern uint8_t graphics_base;
 #define VIC_BASE ((uint16_t)&video_base)
 
 #define SCREEN_WIDTH_TILE (40)
@@ -0,0 +1,143 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#include "spawn.h"
+
+#include <stdlib.h>
+
+#include "isr.h"
+#include "map.h"
+#include "mobs.h"
+
+#define SPAWN_MIN_WAVE (3)
+// Leave a slot for the arrows of the archers
+#define SPAWN_MAX_WAVE (MAX_MOBS - RESERVED_MOBS - 1)
+// Start at half of the largest wave, so that the levels have room to grow it
+#define SPAWN_START_WAVE                                    \
+    (SPAWN_MAX_WAVE / 2 > SPAWN_MIN_WAVE ? SPAWN_MAX_WAVE / 2 \
+                                         : SPAWN_MIN_WAVE)
+
+_Static_assert(SPAWN_MAX_WAVE >= SPAWN_MIN_WAVE, "Too few mobs for a wave");
+
+// The level goes up every 20 seconds, adding one to the wave and making
+// archers more likely (out of 256)
+#define SPAWN_LEVEL_TICKS (20 * 50)
+#define SPAWN_MAX_LEVEL (16)
+#define SPAWN_ARCHER_CHANCE_START (64)
+#define SPAWN_ARCHER_CHANCE_LEVEL (4)
+
+// Ticks between spawns, so that a wave does not all appear at once
+#define SPAWN_DELAY_TICKS (25)
+
+// Frames that end with fewer lines than this before the end of the frame, or
+// that miss a sprite, are under pressure. Each time this happens, the cap on
+// the wave is lowered by one (at most once every SPAWN_BACKOFF_TICKS). The cap
+// is raised by one again after SPAWN_RECOVER_TICKS without any pressure
+#define SPAWN_MIN_HEADROOM_LINES (20)
+#define SPAWN_BACKOFF_TICKS (50)
+#define SPAWN_RECOVER_TICKS (10 * 50)
+
+static uint8_t spawn_level;
+static uint16_t spawn_level_ticks;
+static uint8_t spawn_population;
+static uint8_t spawn_delay;
+static uint8_t spawn_cap;
+static uint8_t spawn_backoff_ticks;
+static uint16_t spawn_calm_ticks;
+static bool spawn_pressure;
+
+static bool spawn_new_enemy(void) {
+    struct map_quad const* quad =
+        &current_screen->spawns[rand() % current_screen->num_spawns];
+    uint8_t archer_chance =
+        SPAWN_ARCHER_CHANCE_START + spawn_level * SPAWN_ARCHER_CHANCE_LEVEL;
+
+    return spawn_enemy(quad->x * QUAD_WIDTH_PX + QUAD_WIDTH_PX / 2,
+                       quad->y * QUAD_HEIGHT_PX + QUAD_HEIGHT_PX / 2,
+                       (uint8_t)rand() < archer_chance);
+}
+
+// Resets the director and spawns the starting wave
+void init_spawns(void) {
+    spawn_level = 0;
+    spawn_level_ticks = 0;
+    spawn_population = 0;
+    spawn_delay = 0;
+    spawn_cap = SPAWN_MAX_WAVE;
+    spawn_backoff_ticks = 0;
+    spawn_calm_ticks = 0;
+    spawn_pressure = false;
+
+    for (uint8_t i = 0; i < SPAWN_START_WAVE; i++) {
+        if (spawn_new_enemy()) {
+            spawn_population++;
+        }
+    }
+}
+
+void tick_spawns(void) {
+    uint8_t wave;
+
+    if (spawn_level < SPAWN_MAX_LEVEL) {
+        spawn_level_ticks++;
+        if (spawn_level_ticks >= SPAWN_LEVEL_TICKS) {
+            spawn_level_ticks = 0;
+            spawn_level++;
+        }
+    }
+
+    if (last_num_missed_sprites) {
+        spawn_pressure = true;
+    }
+
+    if (spawn_backoff_ticks) {
+        spawn_backoff_ticks--;
+    }
+
+    if (spawn_pressure) {
+        spawn_pressure = false;
+        spawn_calm_ticks = 0;
+        if (spawn_backoff_ticks == 0 && spawn_cap > SPAWN_MIN_WAVE) {
+            spawn_cap--;
+            spawn_backoff_ticks = SPAWN_BACKOFF_TICKS;
+        }
+    } else {
+        spawn_calm_ticks++;
+        if (spawn_calm_ticks >= SPAWN_RECOVER_TICKS) {
+            spawn_calm_ticks = 0;
+            if (spawn_cap < SPAWN_MAX_WAVE) {
+                spawn_cap++;
+            }
+        }
+    }
+
+    if (spawn_delay) {
+        spawn_delay--;
+        return;
+    }
+
+    wave = SPAWN_START_WAVE + spawn_level;
+    if (wave > spawn_cap) {
+        wave = spawn_cap;
+    }
+
+    if (spawn_population < wave && spawn_new_enemy()) {
+        spawn_population++;
+        spawn_delay = SPAWN_DELAY_TICKS;
+    }
+}
+
+// Reports the number of raster lines that were left in the frame after the
+// main loop finished its work
+void spawn_report_headroom(uint16_t lines) {
+    if (lines < SPAWN_MIN_HEADROOM_LINES) {
+        spawn_pressure = true;
+    }
+}
+
+// Called when an enemy or powerup leaves the population
+void spawn_remove(void) {
+    if (spawn_population) {
+        spawn_population--;
+    }
+}
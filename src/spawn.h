@@ -0,0 +1,24 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#ifndef _SPAWN_H
+#define _SPAWN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The spawn director keeps a population of enemies (and the powerups they
+// dropped, which take the place of the enemy until they are gone) on the map.
+// The size of the wave and the share of skeleton archers grow over time, but
+// the wave is held back whenever the frame has little headroom left or the
+// multiplexer misses sprites
+void init_spawns(void);
+void tick_spawns(void);
+void spawn_report_headroom(uint16_t lines);
+void spawn_remove(void);
+
+// Creates an enemy at the position, implemented in main.c. Returns false if
+// there is no mob slot for it
+bool spawn_enemy(uint16_t map_x, uint8_t map_y, bool archer);
+
+#endif
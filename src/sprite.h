@@ -49,7 +49,27 @@ struct animation {
 _Static_assert(sizeof(struct animation) == 4,
                "Animation struct size must be power of 2");
 
-extern uint8_t sprite_pointers_shadow[8];
-void update_sprite_pointers();
+// RAM copy of the VIC-II sprite registers. There is one for each bank of
+// raster commands; the main loop only writes the one for the bank it is
+// building (pointed to by sprite_shadow) and the ISR copies the one for the
+// bank it switches to into the VIC-II at the end of each frame. The layout
+// must match isr-handler.S
+struct sprite_registers {
+    uint8_t x[8];
+    uint8_t y[8];
+    uint8_t color[8];
+    uint8_t pointer[8];
+    uint8_t msb;
+    uint8_t enable;
+    uint8_t x_expand;
+    uint8_t y_expand;
+    uint8_t multicolor;
+};
+
+_Static_assert(sizeof(struct sprite_registers) == 37,
+               "Wrong sprite register shadow size");
+
+extern struct sprite_registers sprite_shadows[];
+extern struct sprite_registers* sprite_shadow;
 
 #endif  // SPRITE_H
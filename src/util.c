@@ -219,5 +219,12 @@ uint8_t set_all_ram(void) {
     return p;
 }
 
+uint8_t set_kernal_rom(void) {
+    uint8_t p = PROCESSOR_PORT;
+    PROCESSOR_PORT = (PROCESSOR_PORT & ~MEMORY_MASK) |
+                     MEMORY_BASIC_OFF_KERNAL_ON | _BV(MEMORY_IO_BIT);
+    return p;
+}
+
 void restore_all_ram(uint8_t* port) { PROCESSOR_PORT = *port; }
 
@@ -72,6 +72,7 @@ enum direction dir_from(uint16_t from_x, uint16_t from_y, uint16_t to_x,
                         uint16_t to_y);
 
 uint8_t set_all_ram();
+uint8_t set_kernal_rom();
 void restore_all_ram(uint8_t* port);
 
 uint8_t _disable_int(void);
@@ -88,4 +89,13 @@ void _restore_int(uint8_t* p);
                                     set_all_ram();                          \
          _ram_todo; _ram_todo = 0)
 
+// The KERNAL is banked out while the game is running. Any KERNAL calls must be
+// made inside this block, which banks it back in. Interrupts are then routed
+// through the KERNAL to isr_handler
+#define KERNAL_ROM()                                                          \
+    for (uint8_t _kernal_todo = 1, _kernal_port_save                          \
+                                   __attribute__((cleanup(restore_all_ram))) = \
+                                       set_kernal_rom();                       \
+         _kernal_todo; _kernal_todo = 0)
+
 #endif